@@ -0,0 +1,182 @@
+#include "context.h"
+#include <iostream>
+#include <utility>
+using namespace std;
+
+/*
+ * The destructor frees the published and the retired snapshots.
+ * All sta_reader objects must be destroyed before the context.
+ */
+sta_context::~sta_context(){
+	for(list<pair<u64, const timing_snapshot *> >::iterator i = retired.begin(); i != retired.end(); i++)
+		delete i->second;
+	delete current.load();
+}
+
+/*
+ * load - parses the input file into a new circuit, times it and publishes its snapshot. A context
+ * that was already loaded is replaced as a whole, on error the previous circuit is kept.
+ * @file : the input file name containing complete circuit description
+ *
+ * Returns 0 on success
+ */
+int sta_context::load(const char *file){
+	lock_guard<mutex> l(write_lock);
+	class circuit fresh;
+	if(fresh.parse_input(file) != 0){
+		cerr<<"Error while Parsing input \n";
+		return -1;
+	}
+	swap(ckt, fresh);
+	if(retime() != 0){
+		swap(ckt, fresh);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * edit - applies an edit to the circuit under the writer lock, re-times it and publishes the new
+ * snapshot. Readers keep seeing the previous snapshot until the new one is published.
+ * @fn : function modifying the circuit, returning 0 on success
+ *
+ * Returns 0 on success. If fn or the timing fails nothing is published.
+ */
+int sta_context::edit(const function<int (class circuit &)> &fn){
+	lock_guard<mutex> l(write_lock);
+	if(fn(ckt) != 0)
+		return -1;
+	return retime();
+}
+
+/*
+ * version - Returns the version of the latest published snapshot, 0 if nothing was published yet
+ */
+u64 sta_context::version(){
+	const timing_snapshot *snap = current.load();
+	return snap == NULL ? 0 : snap->version;
+}
+
+/*
+ * retime - recomputes the fan outs and the timing of the whole circuit and publishes the result.
+ * Must be called with the writer lock held.
+ *
+ * Returns 0 on success, -1 if the circuit can't be sorted topologically or timed
+ */
+int sta_context::retime(){
+	list<u32> slist;
+	u32 max_at, min_at;
+
+	/* Edits may have changed the connectivity, so start from a clean state */
+	for(vector<struct gate>::iterator i = ckt.gate_list.begin(); i != ckt.gate_list.end(); i++){
+		i->fan_out = 0;
+		i->a_time = i->r_time = i->slack = -1;
+		i->a_time_min = i->r_time_early = i->hold_slack = -1;
+	}
+	ckt.update_fan_out();
+
+	if(ckt.topo_sort(slist) != 0)
+		return -1;
+	if(ckt.update_arrival_time(slist, max_at, min_at) != 0)
+		return -1;
+	if(ckt.update_slack(slist, max_at, min_at) != 0)
+		return -1;
+
+	timing_snapshot *snap = new timing_snapshot;
+	const timing_snapshot *old = current.load();
+	snap->version = (old == NULL ? 0 : old->version) + 1;
+	snap->num_gates = ckt.num_gates;
+	snap->max_at = max_at;
+	snap->min_at = min_at;
+	snap->a_time.reserve(ckt.num_gates);
+	snap->r_time.reserve(ckt.num_gates);
+	snap->slack.reserve(ckt.num_gates);
+	snap->a_time_min.reserve(ckt.num_gates);
+	snap->r_time_early.reserve(ckt.num_gates);
+	snap->hold_slack.reserve(ckt.num_gates);
+	for(vector<struct gate>::const_iterator i = ckt.gate_list.begin(); i != ckt.gate_list.end(); i++){
+		snap->a_time.push_back(i->a_time);
+		snap->r_time.push_back(i->r_time);
+		snap->slack.push_back(i->slack);
+		snap->a_time_min.push_back(i->a_time_min);
+		snap->r_time_early.push_back(i->r_time_early);
+		snap->hold_slack.push_back(i->hold_slack);
+	}
+	publish(snap);
+	return 0;
+}
+
+/*
+ * publish - swaps in a new snapshot and retires the old one with the epoch after the swap.
+ * A reader that can still see the old snapshot announced an epoch before that one.
+ * @snap : the new snapshot, owned by the context from now on
+ */
+void sta_context::publish(const timing_snapshot *snap){
+	const timing_snapshot *old = current.exchange(snap);
+	u64 e = epoch.fetch_add(1) + 1;
+	if(old != NULL)
+		retired.push_back(make_pair(e, old));
+	reclaim();
+}
+
+/*
+ * reclaim - frees the retired snapshots that no reader can reference any more, i.e. those retired
+ * at an epoch not later than the oldest epoch announced by an active reader.
+ */
+void sta_context::reclaim(){
+	u64 oldest = epoch.load();
+	for(u32 i=0; i<STA_MAX_READERS; i++){
+		u64 e = slots[i].epoch.load();
+		if(e != 0 && e < oldest) oldest = e;
+	}
+	while(!retired.empty() && retired.front().first <= oldest){
+		delete retired.front().second;
+		retired.pop_front();
+	}
+}
+
+/*
+ * The constructor claims a free reader slot of the context. The scan is bounded by
+ * STA_MAX_READERS, check valid() to see if a slot was available.
+ */
+sta_reader::sta_reader(sta_context &c):ctx(c), slot(-1){
+	for(u32 i=0; i<STA_MAX_READERS; i++){
+		bool expected = false;
+		if(ctx.slots[i].used.compare_exchange_strong(expected, true)){
+			slot = i;
+			break;
+		}
+	}
+}
+
+sta_reader::~sta_reader(){
+	if(slot == (u32)(-1)) return;
+	release();
+	ctx.slots[slot].used.store(false);
+}
+
+/*
+ * valid - Returns true if the reader got a slot in the context
+ */
+bool sta_reader::valid(){
+	return slot != (u32)(-1);
+}
+
+/*
+ * acquire - announces the current epoch and loads the latest snapshot
+ *
+ * Returns the snapshot, NULL if nothing was published yet or the reader has no slot
+ */
+const timing_snapshot *sta_reader::acquire(){
+	if(slot == (u32)(-1)) return NULL;
+	ctx.slots[slot].epoch.store(ctx.epoch.load());
+	return ctx.current.load();
+}
+
+/*
+ * release - leaves the epoch, the snapshot returned by acquire() must not be used afterwards
+ */
+void sta_reader::release(){
+	if(slot == (u32)(-1)) return;
+	ctx.slots[slot].epoch.store(0);
+}
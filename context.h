@@ -0,0 +1,103 @@
+/*
+ * This header file contains the analysis context of libsta, used to embed the timer in
+ * multithreaded programs. One writer thread owns the circuit and applies edits to it, after
+ * every edit the circuit is re-timed and an immutable snapshot of the late and early timing is published.
+ * Any number of reader threads can query the latest snapshot without locks while the writer
+ * is working. Old snapshots are freed with epoch based reclamation once no reader uses them.
+ */
+
+#ifndef __CONTEXT_H
+#define __CONTEXT_H
+
+#include "netlist.h"
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+typedef unsigned long long u64;
+
+#define STA_MAX_READERS	64		/* Maximum number of reader threads registered at the same time */
+#define STA_CACHE_LINE	64		/* Size of a cache line, the unit of false sharing */
+
+/* Immutable timing result of one version of the circuit, indexed by gate id */
+struct timing_snapshot{
+	u64					version;	/* Incremented by every publish, starts with 1 */
+	u32					num_gates;	/* Number of gates in the circuit */
+	u32					max_at;		/* Maximum arrival time over all gates */
+	u32					min_at;		/* Minimum early arrival time over the output gates */
+	std::vector<u32>	a_time;		/* Arrival time of each gate */
+	std::vector<u32>	r_time;		/* Required time of each gate */
+	std::vector<u32>	slack;		/* Slack of each gate */
+	std::vector<u32>	a_time_min;	/* Early arrival time of each gate */
+	std::vector<u32>	r_time_early;	/* Early required time of each gate */
+	std::vector<u32>	hold_slack;	/* Hold slack of each gate */
+
+	timing_snapshot():version(0), num_gates(0), max_at(0), min_at(0){}
+};
+
+/* Epoch announced by one reader thread, aligned to its own cache line to avoid false sharing */
+struct alignas(STA_CACHE_LINE) reader_slot{
+	std::atomic<u64>	epoch;		/* Epoch seen when the reader entered, 0 while outside */
+	std::atomic<bool>	used;		/* Set while a sta_reader owns this slot */
+
+	reader_slot():epoch(0), used(false){}
+};
+
+/*
+ * This class abstracts the analysis context. It owns a circuit, the writer side is serialized by
+ * a mutex while the reader side never blocks.
+ */
+class sta_context{
+	class circuit		ckt;		/* Circuit owned by the writer */
+	std::mutex			write_lock;	/* Serializes writers */
+
+	/* Read by every reader, each on its own line so the writer's stores don't bounce the slots */
+	alignas(STA_CACHE_LINE) std::atomic<const timing_snapshot *>	current;	/* Latest published snapshot, NULL before the first publish */
+	alignas(STA_CACHE_LINE) std::atomic<u64>	epoch;		/* Global epoch, advanced by every publish */
+	reader_slot			slots[STA_MAX_READERS];
+
+	/* Snapshots replaced by a publish, freed once every reader has moved past their epoch */
+	std::list<std::pair<u64, const timing_snapshot *> >	retired;
+
+	int retime();
+	void publish(const timing_snapshot *snap);
+	void reclaim();
+
+	/* Not copyable, readers point back to the context */
+	sta_context(const sta_context &);
+	sta_context &operator=(const sta_context &);
+
+	friend class sta_reader;
+
+	public:
+	sta_context():current(NULL), epoch(1){}
+	~sta_context();
+
+	/* For description of these function see corresponding .cpp file */
+	int load(const char *file);
+	int edit(const std::function<int (class circuit &)> &fn);
+	u64 version();
+};
+
+/*
+ * A reader handle, used by one thread at a time. acquire() returns the latest snapshot, which
+ * stays valid until release() or the next acquire(). Both calls are wait-free.
+ */
+class sta_reader{
+	sta_context			&ctx;
+	u32					slot;		/* Index into the context reader slots, -1 if none was free */
+
+	sta_reader(const sta_reader &);
+	sta_reader &operator=(const sta_reader &);
+
+	public:
+	sta_reader(sta_context &c);
+	~sta_reader();
+
+	/* For description of these function see corresponding .cpp file */
+	bool valid();
+	const timing_snapshot *acquire();
+	void release();
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "instream.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+using namespace std;
+
+/*
+ * open - opens the input file, detects its encoding from the magic bytes and starts the
+ * reader thread that fills the double buffer.
+ * @file : the input file name, plain, gzip or zstd compressed
+ *
+ * Returns 0 on success
+ */
+int instream::open(const char *file){
+	unsigned char magic[4] = {0, 0, 0, 0};
+
+	fd = ::open(file, O_RDONLY | O_CLOEXEC);		/* Not inherited by processes forked from other threads */
+	if(fd < 0)
+		return -1;
+
+	/* pread leaves the file offset at the beginning for the plain and gzip readers */
+	ssize_t n = pread(fd, magic, sizeof(magic), 0);
+	if(n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b){
+		type = GZIP_STREAM;
+		gz = gzdopen(fd, "rb");
+		if(gz == NULL){ ::close(fd); fd = -1; return -1; }
+		fd = -1;	/* Owned by zlib now */
+		gzbuffer(gz, INSTREAM_BLOCK_SIZE);
+	}else if(n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd){
+		type = ZSTD_STREAM;
+		::close(fd);
+		fd = -1;
+		if(open_zstd(file) != 0) return -1;
+	}else{
+		type = PLAIN_STREAM;
+	}
+
+	for(int i=0; i<2; i++) blocks[i].data = new char[INSTREAM_BLOCK_SIZE];
+	reader = thread(&instream::read_blocks, this);
+	return 0;
+}
+
+/*
+ * open_zstd - starts a 'zstd' process decompressing the file into a pipe. The decompressor runs
+ * on its own core, so it overlaps with parsing the same way the zlib reader thread does.
+ * @file : the zstd compressed input file
+ *
+ * Returns 0 on success
+ */
+int instream::open_zstd(const char *file){
+	int p[2];
+	if(pipe2(p, O_CLOEXEC) != 0)		/* A stray copy of the write end would hide the end of file */
+		return -1;
+
+	child = fork();
+	if(child < 0){
+		::close(p[0]); ::close(p[1]);
+		return -1;
+	}
+	if(child == 0){
+		dup2(p[1], STDOUT_FILENO);		/* The duplicate is not close-on-exec */
+		::close(p[0]); ::close(p[1]);
+		execlp("zstd", "zstd", "-dcq", "--", file, (char *)NULL);
+		_exit(127);
+	}
+	::close(p[1]);
+	fd = p[0];
+	return 0;
+}
+
+/*
+ * read_source - reads up to len decompressed bytes from the open file. Truncated or corrupt
+ * compressed input is reported as an error here, before the parser sees the end of the stream.
+ *
+ * Returns the number of bytes read, 0 at the end of file and -1 on error
+ */
+long instream::read_source(char *buf, size_t len){
+	if(type == GZIP_STREAM){
+		int err = Z_OK;
+		int n = gzread(gz, buf, (unsigned)len);
+		if(n == 0) gzerror(gz, &err);	/* A truncated stream ends with Z_BUF_ERROR instead of Z_OK */
+		return (n < 0 || err != Z_OK) ? -1 : n;
+	}
+	ssize_t n;
+	do{
+		n = read(fd, buf, len);
+	}while(n < 0 && errno == EINTR);
+
+	/* The decompressor closed the pipe, its exit status tells if the whole stream was valid */
+	if(n == 0 && type == ZSTD_STREAM && child > 0){
+		int status;
+		while(waitpid(child, &status, 0) < 0 && errno == EINTR);
+		child = -1;
+		if(!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) return -1;
+	}
+	return n;
+}
+
+/*
+ * read_blocks - body of the reader thread. Fills the two blocks alternately, waiting for the
+ * parser to release a block before overwriting it. The block holding the end of the stream
+ * (or an error) is marked as 'last'.
+ */
+void instream::read_blocks(){
+	unsigned int w = 0;
+
+	for(;;){
+		{
+			unique_lock<mutex> l(lock);
+			while(blocks[w].full && !stop) cond.wait(l);
+			if(stop) return;
+		}
+
+		/* The block is owned by this thread until it is marked full */
+		long n = read_source(blocks[w].data, INSTREAM_BLOCK_SIZE);
+		{
+			lock_guard<mutex> l(lock);
+			blocks[w].len = n > 0 ? n : 0;
+			blocks[w].last = (n <= 0);
+			blocks[w].full = true;
+			if(n < 0) error = true;
+		}
+		cond.notify_all();
+		if(n <= 0) return;
+		w ^= 1;
+	}
+}
+
+/*
+ * getline - extracts the next line from the stream, without the trailing newline.
+ * Behaves like std::getline, a last line without newline is still returned unless reading
+ * or decompression failed.
+ * @line : receives the line
+ *
+ * Returns false once the stream is exhausted
+ */
+bool instream::getline(string &line){
+	bool any = false;
+	line.clear();
+	if(done) return false;
+
+	for(;;){
+		stream_block &b = blocks[cur];
+
+		/* Wait for the reader to fill the block */
+		if(!held){
+			unique_lock<mutex> l(lock);
+			while(!b.full) cond.wait(l);
+			held = true;
+			pos = 0;
+		}
+		if(b.last){
+			done = true;
+			if(error){		/* Don't hand a partial line of a broken stream to the parser */
+				line.clear();
+				return false;
+			}
+			return any;
+		}
+
+		char *start = b.data + pos;
+		char *nl = (char *)memchr(start, '\n', b.len - pos);
+		if(nl != NULL){
+			line.append(start, nl - start);
+			pos = nl - b.data + 1;
+			return true;
+		}
+
+		/* Line continues in the next block, hand this one back to the reader */
+		if(b.len > pos){
+			line.append(start, b.len - pos);
+			any = true;
+		}
+		{
+			lock_guard<mutex> l(lock);
+			b.full = false;
+			held = false;
+		}
+		cond.notify_all();
+		cur ^= 1;
+	}
+}
+
+/*
+ * close - stops the reader thread, closes the file and reaps the decompressor process
+ *
+ * Returns 0 on success, -1 if reading or decompression failed
+ */
+int instream::close(){
+	if(reader.joinable()){
+		{
+			lock_guard<mutex> l(lock);
+			stop = true;
+		}
+		cond.notify_all();
+		reader.join();
+	}
+	if(gz != NULL){
+		if(gzclose(gz) != Z_OK && done) error = true;	/* Reports a truncated gzip stream */
+		gz = NULL;
+	}
+	if(fd >= 0){ ::close(fd); fd = -1; }
+	if(child > 0){
+		int status;
+		if(!done) kill(child, SIGTERM);		/* Parser stopped early, the decompressor output is not needed */
+		while(waitpid(child, &status, 0) < 0 && errno == EINTR);
+		if(done && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) error = true;
+		child = -1;
+	}
+	for(int i=0; i<2; i++){
+		delete []blocks[i].data;
+		blocks[i] = stream_block();
+	}
+	return error ? -1 : 0;
+}
+
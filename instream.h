@@ -0,0 +1,74 @@
+/*
+ * This header file contains the streaming input pipeline used by the parser.
+ * A reader thread fills two fixed size blocks from the input file (decompressing it
+ * if needed) while the parser tokenizes the other block, so I/O, decompression and
+ * graph building overlap. Memory use is bounded by the two blocks plus the current line.
+ */
+
+#ifndef __INSTREAM_H
+#define __INSTREAM_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <sys/types.h>
+#include <zlib.h>
+
+#define INSTREAM_BLOCK_SIZE	(1 << 20)	/* Size of each of the two blocks in bytes */
+
+/* Encoding of the input file, detected from its magic bytes */
+enum stream_t {PLAIN_STREAM, GZIP_STREAM, ZSTD_STREAM};
+
+/* A block of the double buffer shared between the reader thread and the parser */
+struct stream_block{
+	char				*data;		/* Bytes read from the file */
+	size_t				len;		/* Number of valid bytes in data */
+	bool				full;		/* Set by the reader when filled, cleared by the parser when consumed */
+	bool				last;		/* Set on the block that ends the stream */
+
+	stream_block():data(NULL), len(0), full(false), last(false){}
+};
+
+/*
+ * This class abstracts a line oriented input stream for plain, gzip and zstd compressed files.
+ * Gzip files are inflated with zlib, zstd files are piped through the 'zstd' tool.
+ */
+class instream{
+	stream_t			type;		/* Encoding of the open file */
+	int					fd;			/* File descriptor for plain files, read end of the pipe for zstd */
+	gzFile				gz;			/* zlib handle for gzip files */
+	pid_t				child;		/* Decompressor process for zstd files */
+
+	stream_block		blocks[2];	/* Double buffer */
+	unsigned int		cur;		/* Block currently consumed by the parser */
+	size_t				pos;		/* Position of the parser inside the current block */
+	bool				held;		/* Set while the parser owns the current block */
+	bool				done;		/* Set once the parser has seen the end of the stream */
+	bool				error;		/* Set if reading or decompression failed */
+	bool				stop;		/* Asks the reader thread to quit early */
+
+	std::thread			reader;
+	std::mutex			lock;
+	std::condition_variable	cond;
+
+	void read_blocks();
+	long read_source(char *buf, size_t len);
+	int open_zstd(const char *file);
+
+	/* Not copyable, the reader thread points back to this object */
+	instream(const instream &);
+	instream &operator=(const instream &);
+
+	public:
+	instream():type(PLAIN_STREAM), fd(-1), gz(NULL), child(-1), cur(0), pos(0), held(false), done(false), error(false), stop(false){}
+	~instream(){ close(); }
+
+	/* For description of these function see corresponding .cpp file */
+	int open(const char *file);
+	bool getline(std::string &line);
+	int close();
+};
+
+#endif
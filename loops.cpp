@@ -0,0 +1,178 @@
+#include "netlist.h"
+#include <iostream>
+using namespace std;
+
+#define min(a,b) ((a)<(b)?(a):(b))
+
+/*
+ * find_loops - finds the combinational loops of the circuit as the strongly connected components
+ * of the gate graph with more than one gate, or with a gate driving itself.
+ * This is Tarjan's algorithm with an explicit call stack over flat arrays, so it runs in linear time
+ * and does not overflow the stack on deep netlists.
+ * @loops : receives the gate ids of each loop
+ *
+ * Returns the number of loops found
+ */
+u32 circuit::find_loops(vector<vector<u32> > &loops){
+	const u32 none = -1;
+	vector<u32> off, succ;
+	gate_successors(off, succ);
+
+	vector<u32> index(num_gates, none);	/* Discovery order, none while unvisited */
+	vector<u32> low(num_gates);			/* Smallest index reachable through the DFS subtree */
+	vector<u32> edge(num_gates);			/* Next successor of each gate to visit */
+	vector<char> on_stack(num_gates, 0);
+	vector<u32> stack, call;
+	u32 counter = 0;
+
+	loops.clear();
+	for(u32 root=0; root<num_gates; root++){
+		if(index[root] != none) continue;
+
+		index[root] = low[root] = counter++;
+		edge[root] = off[root];
+		stack.push_back(root);
+		on_stack[root] = 1;
+		call.push_back(root);
+
+		while(!call.empty()){
+			u32 v = call.back();
+			if(edge[v] < off[v+1]){
+				/* Descend into the next successor */
+				u32 w = succ[edge[v]++];
+				if(index[w] == none){
+					index[w] = low[w] = counter++;
+					edge[w] = off[w];
+					stack.push_back(w);
+					on_stack[w] = 1;
+					call.push_back(w);
+				}else if(on_stack[w]){
+					low[v] = min(low[v], index[w]);
+				}
+				continue;
+			}
+
+			/* All successors done, return to the parent */
+			call.pop_back();
+			if(!call.empty()) low[call.back()] = min(low[call.back()], low[v]);
+			if(low[v] != index[v]) continue;
+
+			/* v is the root of a component, pop it from the stack. Most components are single gates, only loops are copied */
+			u32 start = stack.size() - 1;
+			while(stack[start] != v) start--;
+			bool loop = start + 1 < stack.size();
+			for(u32 e = off[v]; e < off[v+1] && !loop; e++)
+				if(succ[e] == v) loop = true;		/* Self loop */
+			if(loop)
+				loops.push_back(vector<u32>(stack.begin() + start, stack.end()));
+			for(u32 k = start; k < stack.size(); k++)
+				on_stack[stack[k]] = 0;
+			stack.resize(start);
+		}
+	}
+	return loops.size();
+}
+
+/*
+ * report_loops - prints the gates and nets of each loop by name. A gate is named after the net
+ * it drives. The nets listed are the ones that connect two gates of the same loop, breaking
+ * any one of them (break_nets()) opens the loop.
+ * @loops : the loops returned by find_loops()
+ * @out : the stream to print to
+ */
+void circuit::report_loops(vector<vector<u32> > &loops, ostream &out){
+	vector<const string *> net_name;
+	net_names(net_name);
+
+	vector<u32> loop_of(num_gates, -1);
+	for(u32 l=0; l<loops.size(); l++)
+		for(vector<u32>::const_iterator g = loops[l].begin(); g != loops[l].end(); g++)
+			loop_of[*g] = l;
+
+	for(u32 l=0; l<loops.size(); l++){
+		out<<"Combinational loop "<<l+1<<" with "<<loops[l].size()<<" gates\n";
+		out<<"  Gates:";
+		for(vector<u32>::const_iterator g = loops[l].begin(); g != loops[l].end(); g++){
+			const list<u32> &nets = gate_list[*g].nets;
+			if(!nets.empty() && net_name[nets.front()] != NULL) out<<" "<<*net_name[nets.front()];
+			else out<<" #"<<*g;
+			out<<"("<<get_gate_name(gate_list[*g].type)<<")";
+		}
+		out<<"\n  Nets:";
+		for(vector<u32>::const_iterator g = loops[l].begin(); g != loops[l].end(); g++){
+			for(list<u32>::const_iterator j = gate_list[*g].nets.begin(); j != gate_list[*g].nets.end(); j++){
+				bool in_loop = false;
+				for(list<u32>::const_iterator k = net_list[*j].gates.begin(); k != net_list[*j].gates.end(); k++)
+					if(loop_of[*k] == l) in_loop = true;
+				if(in_loop) out<<" "<<(net_name[*j] != NULL ? *net_name[*j] : "?");
+			}
+		}
+		out<<"\n";
+	}
+}
+
+/*
+ * break_nets - opens the loops running through the given nets. Each net is disconnected from the
+ * gates it drives inside its own loop, the gates outside the loop keep it as input. The gates that
+ * lose an input are timed from their remaining inputs, a driver left without fan out is marked cut
+ * and stays unconstrained in update_slack(). Must be called before update_fan_out().
+ * @names : the names of the nets
+ *
+ * Returns 0 on success, -1 if a net does not exist or it drives a black-box instance in its loop
+ */
+int circuit::break_nets(vector<string> &names){
+	vector<vector<u32> > loops;
+	find_loops(loops);
+	vector<u32> loop_of(num_gates, -1);
+	for(u32 l=0; l<loops.size(); l++)
+		for(vector<u32>::const_iterator g = loops[l].begin(); g != loops[l].end(); g++)
+			loop_of[*g] = l;
+
+	for(vector<string>::const_iterator n = names.begin(); n != names.end(); n++){
+		map<string, u32>::const_iterator ni = edge_map.find(*n);
+		if(ni == edge_map.end()){
+			cerr<<"No net named "<<*n<<" to break\n";
+			return -1;
+		}
+		struct net &cut = net_list[ni->second];
+		u32 l = (cut.driving_gate < num_gates) ? loop_of[cut.driving_gate] : (u32)(-1);
+		if(l == (u32)(-1)){
+			cerr<<"Net "<<*n<<" is not part of a loop, left connected\n";
+			continue;
+		}
+
+		list<u32> keep;
+		for(list<u32>::const_iterator k = cut.gates.begin(); k != cut.gates.end(); k++){
+			struct gate &g = gate_list[*k];
+			if(loop_of[*k] != l){
+				keep.push_back(*k);
+				continue;
+			}
+			if(g.inst != (u32)(-1)){
+				cerr<<"Can't break net "<<*n<<", it drives a model instance\n";
+				return -1;
+			}
+			/* A gate appears once per pin on the net, all pins are removed on the first visit */
+			for(list<u32>::iterator j = g.in_nets.begin(); j != g.in_nets.end(); ){
+				if(*j == cut.id){
+					j = g.in_nets.erase(j);
+					g.fan_in--;
+				}else{
+					j++;
+				}
+			}
+		}
+		cut.gates = keep;
+		gate_list[cut.driving_gate].cut = true;
+
+		/* Recount the net under the type it now has, see add_gate_to_net() and add_output_edge() */
+		if(cut.type == HYPEREDGE && cut.gates.size() <= 1){
+			bool in = gate_list[cut.driving_gate].type == get_gate_type("INPUT");
+			bool out = !cut.gates.empty() && gate_list[cut.gates.front()].type == get_gate_type("OUTPUT");
+			net_type[cut.type]--;
+			cut.type = in ? (out ? IO_NET : INPUT_NET) : (out ? OUTPUT_NET : INTERNAL_NET);
+			net_type[cut.type]++;
+		}
+	}
+	return 0;
+}
@@ -2,16 +2,25 @@
  * This file contains the main function.
  * This function calls the function for parsing input file and building graph data structures.
  * Then it calls some functions for generating statistics
- * The output file is stored in .out file
+ * The output file is stored in .out file, or in the binary result format with -b (see result.h)
  * 
+ * Usage: sta [-b] [-n] [-m <model_file>] [-x <net,...>] <input_file> <output_file>
+ *        sta -t <binary_result_file> <output_file>
+ *   -b : write the binary result format instead of text
+ *   -n : with -b, also store the net names
+ *   -m : also extract the abstract timing model of the circuit into model_file (see model.h)
+ *   -x : break combinational loops at the given nets, can be repeated
+ *   -t : convert a binary result file into the text format
  */
 
 #include "netlist.h"
+#include "result.h"
 #include <iostream>
 #include <vector>
 #include <list>
 #include <cstring>
 #include <fstream>
+#include <unistd.h>
 
 using namespace std;
 void print(class circuit &);
@@ -21,24 +30,65 @@ int main(int argc, char **argv){
 	class circuit c;
 	list<u32> slist;		/* List containing topologically sorted gates */
 	u32 max_at;				/* Maximum arrival time */
+	u32 min_at;				/* Minimum early arrival time at the outputs */
+	bool binary = false, names = false, convert = false;
+	const char *model_file = NULL;
+	string break_nets;		/* Comma separated nets given with -x */
+	int opt;
 	
-	if(argc != 3){
+	while((opt = getopt(argc, argv, "bntm:x:")) != -1){
+		switch(opt){
+			case 'b': binary = true; break;
+			case 'n': names = true; break;
+			case 't': convert = true; break;
+			case 'm': model_file = optarg; break;
+			case 'x': break_nets += string(optarg) + ","; break;
+			default:
+				cout<<"Usage: "<<argv[0]<<" [-b] [-n] [-m <model_file>] [-x <net,...>] <input_file> <output_file>\n";
+				cout<<"       "<<argv[0]<<" -t <binary_result_file> <output_file>\n";
+				return 1;
+		}
+	}
+	if(argc - optind != 2){
 		cout<<"Error: Please specify an input and an output file.\n";
 		return 1;
 	}
+	if(names && !binary){
+		cout<<"Error: -n only applies to the binary result, use it with -b.\n";
+		return 1;
+	}
+	const char *in_file = argv[optind], *out_file = argv[optind + 1];
+
+	/* Only convert an existing binary result to text */
+	if(convert){
+		if(convert_result(in_file, out_file) != 0) return 1;
+		cout<<"Result converted, check output file\n";
+		return 0;
+	}
 
 	/* Parse the input file and generate the graph data structures */
-	if(c.parse_input(argv[1]) != 0){
+	if(c.parse_input(in_file) != 0){
 		cerr<<"Error while Parsing input \n";
 		return 1;
 	}
 
 
+	/* Open the loops at the nets chosen by the user */
+	if(!break_nets.empty()){
+		vector<string> names;
+		for(size_t start = 0, end; (end = break_nets.find(',', start)) != string::npos; start = end + 1)
+			if(end > start) names.push_back(break_nets.substr(start, end - start));
+		if(c.break_nets(names) != 0) return 1;
+	}
+
 	/* Opening the output file for storing result */
-	ofstream fout(argv[2]);
-	if(!fout.is_open()){
-		cerr<<"Can't open output file for writing\n";
-		return -1;
+	ofstream fout;
+	if(!binary){
+		fout.open(out_file);
+		if(!fout.is_open()){
+			cerr<<"Can't open output file for writing\n";
+			return -1;
+		}
 	}
 	
 	/* Calculate the fan out for all the gates in the netlist */
@@ -51,6 +101,13 @@ int main(int argc, char **argv){
 	/* Sort the ciruit using topological sort */ 
 	if(c.topo_sort(slist) != 0){
 		cout<<"Topo Sort failed "<<endl;
+		
+		/* Tell the user where the loops are */
+		vector<vector<u32> > loops;
+		if(c.find_loops(loops) != 0){
+			c.report_loops(loops, cerr);
+			cerr<<"Use -x <net> to break the loops at one net each\n";
+		}
 		fout.close();
 		return(-1);
 	}
@@ -58,39 +115,37 @@ int main(int argc, char **argv){
 	//cout<<"Topological sorting "<<endl;
 	//for(list<u32>::const_iterator i = slist.begin(); i != slist.end(); i++)		cout<<*i<<endl;
 
-	/* Update the arrival time */
-	c.update_arrival_time(slist, max_at);
-
-	
-	/* Update the slack */
-	c.update_slack(slist, max_at);
+	/* Update the late and early arrival times */
+	if(c.update_arrival_time(slist, max_at, min_at) != 0){
+		fout.close();
+		return(-1);
+	}
 
-	fout<<max_at<<endl;			/* maximum delay over all nodes */
 	
-	/* Generating the index of adjacency list entries for INPUT gates */
-	u32 gtype = c.get_gate_type("INPUT");
-	fout<<c.gate_type[gtype]<<" ";
-	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++)
-		if(i->type==gtype) {
-			fout<<i->id<<" ";
-		}
-	fout<<endl;
+	/* Update the setup and hold slack */
+	if(c.update_slack(slist, max_at, min_at) != 0){
+		fout.close();
+		return(-1);
+	}
 
-	/* Generating the index of adjacency list entries for OUTPUT gates */
-	gtype=c.get_gate_type("OUTPUT");
-	fout<<c.gate_type[gtype]<<" ";
-	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++)
-		if(i->type==gtype){
-			fout<<i->id<<" ";
+	/* Extract the interface timing model for reuse in a parent netlist */
+	if(model_file != NULL){
+		timing_model m;
+		if(extract_model(c, slist, max_at, m, 0) != 0){
+			cerr<<"Model extraction failed\n";
+			return -1;
 		}
-	fout<<endl;
-
-
-
-	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++)
-		fout<<i->id<<" "<<i->a_time<<" "<<i->slack<<"\n";
+		string name(in_file);
+		m.name = name.substr(name.rfind('/') == string::npos ? 0 : name.rfind('/') + 1);
+		if(write_model(m, model_file) != 0) return -1;
+	}
 
-	fout<<endl;
+	/* Write the result */
+	if(binary){
+		if(write_binary_result(c, max_at, min_at, out_file, names) != 0) return -1;
+	}else{
+		write_text_result(fout, c, max_at);
+	}
 	
 	//print(c);
 
@@ -102,7 +157,7 @@ int main(int argc, char **argv){
 }
 void print_slack(class circuit &c){
 	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++)
-		cout<<i->id<<" "<<i->a_time<<" "<<i->slack<<endl;
+		cout<<i->id<<" "<<i->a_time<<" "<<i->slack<<" "<<i->a_time_min<<" "<<i->hold_slack<<endl;
 
 }
 void print(class circuit &c){
@@ -123,7 +178,8 @@ void print(class circuit &c){
 	cout<<"\nGate List\n";
 	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++){
 		cout<<"\n\nGate:: [id: "<<i->id<<"] [Type: "<<c.get_gate_name(i->type)<<"] [fan_in: "<<i->fan_in<<"] [fan_out: "<<i->fan_out<<"]"
-					<<" [a_time: "<<i->a_time<<"] [r_time: "<<i->r_time<<"] [slack: "<<i->slack<<"] [flag: "<<i->flag<<"] ";
+					<<" [a_time: "<<i->a_time<<"] [r_time: "<<i->r_time<<"] [slack: "<<i->slack<<"]"
+					<<" [a_time_min: "<<i->a_time_min<<"] [r_time_early: "<<i->r_time_early<<"] [hold_slack: "<<i->hold_slack<<"] [flag: "<<i->flag<<"] ";
 		cout<<"\n Input Edges: ";
 		for(list<u32>::const_iterator j = i->in_nets.begin(); j != i->in_nets.end(); j++)
 			cout<<"  "<<c.get_edge_name(c.net_list[*j].id)<<" [ID: "<<c.net_list[*j].id<<"]";
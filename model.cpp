@@ -0,0 +1,514 @@
+#include "netlist.h"
+#include <iostream>
+#include <fstream>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+using namespace std;
+
+#define max(a,b) ((a)>(b)?(a):(b))
+#define min(a,b) ((a)<(b)?(a):(b))
+
+/*
+ * order_outputs - sorts the outputs of a model so that an output comes after every output that
+ * reaches it through the logic of the block (delay from source num_inputs + a to b).
+ * @m : the model, out_order is set
+ *
+ * Returns 0 on success, -1 if the outputs depend on each other in a loop
+ */
+static int order_outputs(timing_model &m){
+	u32 no = m.num_outputs;
+	vector<u32> pending(no, 0);
+	m.out_order.clear();
+	for(u32 a=0; a<no; a++)
+		for(u32 b=0; b<no; b++)
+			if(m.delay[(size_t)(m.num_inputs + a) * no + b] != (u32)(-1)) pending[b]++;
+	for(u32 b=0; b<no; b++)
+		if(pending[b] == 0) m.out_order.push_back(b);
+	for(u32 k=0; k<m.out_order.size(); k++){
+		u32 a = m.out_order[k];
+		for(u32 b=0; b<no; b++)
+			if(m.delay[(size_t)(m.num_inputs + a) * no + b] != (u32)(-1) && --pending[b] == 0)
+				m.out_order.push_back(b);
+	}
+	return m.out_order.size() == no ? 0 : -1;
+}
+
+/*
+ * extract_model - extracts the interface timing model of a timed circuit.
+ * The delay matrices are computed with one sparse propagation per source: starting from the input
+ * gate (or the gate driving an output) only its fan out cone is visited, in topological order, so
+ * the cost is the size of the cone and not of the circuit. The source net starts at time 0 and the
+ * propagation stops at the gates driving the outputs, their delay depends on the parent.
+ * The sources are distributed over 'threads' worker threads, each with its own scratch arrays.
+ * @c : the circuit, after update_arrival_time() and update_slack() were called
+ * @slist : topologically sorted list of gates
+ * @max_at : the maximum arrival time returned by update_arrival_time()
+ * @m : receives the model
+ * @threads : number of worker threads, 0 to use one per core
+ *
+ * Returns 0 on success
+ */
+int extract_model(class circuit &c, list<u32> &slist, u32 max_at, timing_model &m, u32 threads){
+	if(slist.size() != c.num_gates) return -1;
+	if(!c.inst_list.empty()){
+		cerr<<"Can't extract a model from a circuit containing model instances\n";
+		return -1;
+	}
+	u32 in_type = c.get_gate_type("INPUT");
+	u32 out_type = c.get_gate_type("OUTPUT");
+	u32 n = c.num_gates;
+
+	/* Position of each gate in the topological order */
+	vector<u32> rank(n);
+	u32 r = 0;
+	for(list<u32>::const_iterator i = slist.begin(); i != slist.end(); i++) rank[*i] = r++;
+
+	/* Flatten the gate to gate edges into a CSR array, the lists are too slow to walk per input */
+	vector<u32> succ_off, succ;
+	c.gate_successors(succ_off, succ);
+
+	vector<const string *> net_name;
+	c.net_names(net_name);
+
+	/* The load of a boundary net inside the block, the output gates are replaced by the parent */
+	auto inner_load = [&](const struct net &bnet){
+		u32 load = 0;
+		for(list<u32>::const_iterator k = bnet.gates.begin(); k != bnet.gates.end(); k++)
+			if(c.gate_list[*k].type != out_type) load++;
+		return load;
+	};
+
+	/* Collect the boundary of the block, an output gate has a single input net */
+	vector<u32> sources, drivers, in_index(n, -1);
+	vector<char> is_driver(n, 0);
+	m = timing_model();
+	m.max_at = max_at;
+	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++){
+		if(i->type == in_type){
+			in_index[i->id] = sources.size();
+			sources.push_back(i->id);
+			m.input_names.push_back(*net_name[i->nets.front()]);
+			m.in_rt.push_back(i->r_time);
+			m.in_rt_early.push_back(i->r_time_early);
+			m.in_load.push_back(inner_load(c.net_list[i->nets.front()]));
+		}else if(i->type == out_type){
+			const struct net &onet = c.net_list[i->in_nets.front()];
+			drivers.push_back(onet.driving_gate);
+			m.output_names.push_back(*net_name[onet.id]);
+			m.out_at.push_back(i->a_time);
+			m.out_at_min.push_back(i->a_time_min);
+			m.out_load.push_back(inner_load(onet));
+		}
+	}
+	m.num_inputs = m.input_names.size();
+	m.num_outputs = m.output_names.size();
+	m.out_feed.assign(m.num_outputs, -1);
+	sources.insert(sources.end(), drivers.begin(), drivers.end());
+	m.delay.assign(sources.size() * m.num_outputs, -1);
+	m.delay_min.assign(sources.size() * m.num_outputs, -1);
+
+	/* An output driven by an input is the same net, it has no gate delay and its load is the input's */
+	for(u32 o=0; o<m.num_outputs; o++){
+		if(c.gate_list[drivers[o]].type != in_type){
+			is_driver[drivers[o]] = 1;
+			continue;
+		}
+		u32 i = in_index[drivers[o]];
+		m.out_feed[o] = i;
+		m.out_load[o] = 0;
+		m.delay[(size_t)i * m.num_outputs + o] = m.delay_min[(size_t)i * m.num_outputs + o] = 0;
+	}
+
+	/* Worker: propagates the late and early arrival from one source at a time */
+	atomic<u32> next(0);
+	function<void ()> worker = [&](){
+		vector<u32> at(n, -1), at_min(n, -1), touched;
+		priority_queue<pair<u32, u32>, vector<pair<u32, u32> >, greater<pair<u32, u32> > > q;	/* (rank, gate) */
+
+		for(u32 s = next++; s < sources.size(); s = next++){
+			if(s >= m.num_inputs && m.out_feed[s - m.num_inputs] != (u32)(-1)) continue;	/* Same as the input */
+			u32 g0 = sources[s];
+			at[g0] = at_min[g0] = 0;
+			touched.push_back(g0);
+			q.push(make_pair(rank[g0], g0));
+
+			/* A gate is popped after all its predecessors in the cone, so its arrival is final */
+			while(!q.empty()){
+				u32 g = q.top().second;
+				q.pop();
+				if(is_driver[g] && g != g0) continue;		/* Timed from its own source */
+				for(u32 e = succ_off[g]; e < succ_off[g+1]; e++){
+					u32 k = succ[e];
+					u32 d = c.gate_list[k].fan_out;
+					if(at[k] == (u32)(-1)){
+						at[k] = at[g] + d;
+						at_min[k] = at_min[g] + d;
+						touched.push_back(k);
+						q.push(make_pair(rank[k], k));
+					}else{
+						at[k] = max(at[k], at[g] + d);
+						at_min[k] = min(at_min[k], at_min[g] + d);
+					}
+				}
+			}
+
+			/* Record the arrival at the input of the reached output gates and reset only what was touched */
+			for(u32 o=0; o<m.num_outputs; o++){
+				u32 d = drivers[o];
+				if(at[d] == (u32)(-1) || d == g0 || m.out_feed[o] != (u32)(-1)) continue;
+				size_t idx = (size_t)s * m.num_outputs + o;
+				m.delay[idx] = at[d] - c.gate_list[d].fan_out;
+				m.delay_min[idx] = at_min[d] - c.gate_list[d].fan_out;
+			}
+			for(vector<u32>::const_iterator t = touched.begin(); t != touched.end(); t++)
+				at[*t] = at_min[*t] = -1;
+			touched.clear();
+		}
+	};
+
+	if(threads == 0) threads = thread::hardware_concurrency();
+	if(threads == 0) threads = 1;
+	if(threads > sources.size()) threads = max((u32)sources.size(), 1u);
+	vector<thread> pool;
+	for(u32 t=1; t<threads; t++) pool.push_back(thread(worker));
+	worker();
+	for(vector<thread>::iterator t = pool.begin(); t != pool.end(); t++) t->join();
+	return order_outputs(m);
+}
+
+/*
+ * write_model - writes a model in its text format:
+ *   MODEL <name>
+ *   MAX_AT <max_at>
+ *   INPUTS <count>, then one "<net> <required time> <early required time> <load>" line per input
+ *   OUTPUTS <count>, then one "<net> <arrival time> <early arrival time> <load> <feed>" line per output,
+ *           feed is the index of the input driving the output directly, -1 if none
+ *   DELAYS <count>, then one "<source index> <output index> <delay> <min delay>" line per connected pair
+ * @m : the model
+ * @file : the output file name
+ *
+ * Returns 0 on success
+ */
+int write_model(timing_model &m, const char *file){
+	ofstream out(file);
+	if(!out.is_open()){
+		cerr<<"Can't open model file for writing: "<<file<<endl;
+		return -1;
+	}
+	size_t count = 0;
+	for(vector<u32>::const_iterator d = m.delay.begin(); d != m.delay.end(); d++)
+		if(*d != (u32)(-1)) count++;
+
+	out<<"MODEL "<<(m.name.empty() ? "-" : m.name)<<"\n";
+	out<<"MAX_AT "<<m.max_at<<"\n";
+	out<<"INPUTS "<<m.num_inputs<<"\n";
+	for(u32 i=0; i<m.num_inputs; i++)
+		out<<m.input_names[i]<<" "<<m.in_rt[i]<<" "<<m.in_rt_early[i]<<" "<<m.in_load[i]<<"\n";
+	out<<"OUTPUTS "<<m.num_outputs<<"\n";
+	for(u32 o=0; o<m.num_outputs; o++)
+		out<<m.output_names[o]<<" "<<m.out_at[o]<<" "<<m.out_at_min[o]<<" "<<m.out_load[o]<<" "<<(int)m.out_feed[o]<<"\n";
+	out<<"DELAYS "<<count<<"\n";
+	for(u32 s=0; s<m.num_inputs + m.num_outputs; s++)
+		for(u32 o=0; o<m.num_outputs; o++){
+			size_t idx = (size_t)s * m.num_outputs + o;
+			if(m.delay[idx] != (u32)(-1))
+				out<<s<<" "<<o<<" "<<m.delay[idx]<<" "<<m.delay_min[idx]<<"\n";
+		}
+	out.close();
+	if(out.fail()){
+		cerr<<"Error while writing model file: "<<file<<endl;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * read_model - reads a model written by write_model()
+ * @file : the model file name
+ * @m : receives the model
+ *
+ * Returns 0 on success
+ */
+int read_model(const char *file, timing_model &m){
+	ifstream in(file);
+	string key;
+	size_t count;
+
+	if(!in.is_open()){
+		cerr<<"Can't open model file: "<<file<<endl;
+		return -1;
+	}
+	m = timing_model();
+	in>>key>>m.name;
+	bool ok = (key == "MODEL");
+	in>>key>>m.max_at;
+	ok = ok && key == "MAX_AT";
+	in>>key>>m.num_inputs;
+	ok = ok && key == "INPUTS" && in.good();
+	if(ok){
+		m.input_names.resize(m.num_inputs);
+		m.in_rt.resize(m.num_inputs);
+		m.in_rt_early.resize(m.num_inputs);
+		m.in_load.resize(m.num_inputs);
+		for(u32 i=0; i<m.num_inputs; i++) in>>m.input_names[i]>>m.in_rt[i]>>m.in_rt_early[i]>>m.in_load[i];
+		in>>key>>m.num_outputs;
+		ok = key == "OUTPUTS" && in.good();
+	}
+	if(ok){
+		m.output_names.resize(m.num_outputs);
+		m.out_at.resize(m.num_outputs);
+		m.out_at_min.resize(m.num_outputs);
+		m.out_load.resize(m.num_outputs);
+		m.out_feed.resize(m.num_outputs);
+		for(u32 o=0; o<m.num_outputs && ok; o++){
+			int feed;
+			in>>m.output_names[o]>>m.out_at[o]>>m.out_at_min[o]>>m.out_load[o]>>feed;
+			m.out_feed[o] = feed;
+			ok = feed >= -1 && feed < (int)m.num_inputs;
+		}
+		in>>key>>count;
+		ok = ok && key == "DELAYS" && in.good();
+	}
+	if(ok){
+		size_t sources = (size_t)m.num_inputs + m.num_outputs;
+		m.delay.assign(sources * m.num_outputs, -1);
+		m.delay_min.assign(sources * m.num_outputs, -1);
+		for(size_t e=0; e<count && ok; e++){
+			u32 s, o, d, dmin;
+			in>>s>>o>>d>>dmin;
+			ok = !in.fail() && s < sources && o < m.num_outputs;
+			if(ok){
+				m.delay[(size_t)s * m.num_outputs + o] = d;
+				m.delay_min[(size_t)s * m.num_outputs + o] = dmin;
+			}
+		}
+	}
+	if(!ok || in.fail() || order_outputs(m) != 0){
+		cerr<<"Invalid model file: "<<file<<endl;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * add_model - loads a model file and registers it under 'name' for instantiation
+ * @name : name used by the instance lines of the netlist
+ * @file : the model file name
+ *
+ * Returns 0 on success
+ */
+int circuit::add_model(string &name, string &file){
+	if(name.empty() || model_map.find(name) != model_map.end()){
+		cerr<<"Invalid or duplicate model name: "<<name<<endl;
+		return -1;
+	}
+	timing_model m;
+	if(read_model(file.c_str(), m) != 0)
+		return -1;
+	model_map[name] = models.size();
+	models.push_back(m);
+	return 0;
+}
+
+/*
+ * add_model_instance - adds a black-box gate instantiating a model and connects it to its nets
+ * @model : index of the model in models
+ * @outs : net connected to each model output
+ * @ins : net connected to each model input
+ *
+ * Returns the index (in the gate_list adjacency list) of the new gate
+ */
+u32 circuit::add_model_instance(u32 model, vector<u32> &outs, vector<u32> &ins){
+	u32 gate_id = add_gate(get_gate_type("MODEL"));
+	struct model_inst temp;
+	temp.model = model;
+	temp.gate = gate_id;
+	temp.out_nets = outs;
+	temp.in_nets = ins;
+	for(u32 o=0; o<outs.size(); o++){
+		add_outnet_to_gate(gate_id, outs[o]);
+		net_list[outs[o]].driving_gate = gate_id;
+		temp.out_pins.push_back(make_pair(outs[o], o));
+	}
+	for(u32 i=0; i<ins.size(); i++){
+		add_gate_to_net(ins[i], gate_id);
+		gate_list[gate_id].in_nets.push_back(ins[i]);
+		temp.in_pins.push_back(make_pair(ins[i], i));
+	}
+	sort(temp.out_pins.begin(), temp.out_pins.end());
+	sort(temp.in_pins.begin(), temp.in_pins.end());
+	temp.at.assign(outs.size(), -1);
+	temp.at_min.assign(outs.size(), -1);
+	temp.rt.assign(ins.size(), -1);
+	temp.rt_early.assign(ins.size(), 0);
+	gate_list[gate_id].inst = inst_list.size();
+	inst_list.push_back(temp);
+	return gate_id;
+}
+
+/* Returns the output pin of 'inst' driving net 'net_id' */
+static u32 out_pin(const struct model_inst &inst, u32 net_id){
+	return lower_bound(inst.out_pins.begin(), inst.out_pins.end(), make_pair(net_id, 0u))->second;
+}
+
+/*
+ * net_at - Returns the arrival time of a net, i.e. of the output of its driving gate.
+ * For a net driven by a black-box instance the arrival of that instance output is returned.
+ */
+u32 circuit::net_at(u32 net_id){
+	struct gate &g = gate_list[net_list[net_id].driving_gate];
+	if(g.inst == (u32)(-1)) return g.a_time;
+	struct model_inst &inst = inst_list[g.inst];
+	return inst.at[out_pin(inst, net_id)];
+}
+
+/*
+ * net_at_min - Returns the early arrival time of a net, see net_at()
+ */
+u32 circuit::net_at_min(u32 net_id){
+	struct gate &g = gate_list[net_list[net_id].driving_gate];
+	if(g.inst == (u32)(-1)) return g.a_time_min;
+	struct model_inst &inst = inst_list[g.inst];
+	return inst.at_min[out_pin(inst, net_id)];
+}
+
+/*
+ * sink_rt - Returns the time by which net 'net_id' has to arrive at its sink 'gate_id',
+ * -1 if the sink drives nothing (e.g. after break_nets()). A net connected to several inputs
+ * of a black-box instance gets the tightest of them.
+ */
+u32 circuit::sink_rt(u32 net_id, u32 gate_id){
+	struct gate &g = gate_list[gate_id];
+	if(g.inst == (u32)(-1)) return g.r_time == (u32)(-1) ? g.r_time : g.r_time - g.fan_out;	/* -1: the sink is unconstrained */
+	struct model_inst &inst = inst_list[g.inst];
+	u32 rt = -1;
+	vector<pair<u32, u32> >::const_iterator p = lower_bound(inst.in_pins.begin(), inst.in_pins.end(), make_pair(net_id, 0u));
+	for(; p != inst.in_pins.end() && p->first == net_id; p++)
+		rt = min(rt, inst.rt[p->second]);
+	return rt;
+}
+
+/*
+ * sink_rt_early - Returns the earliest time net 'net_id' may arrive at its sink 'gate_id', 0 if unconstrained
+ */
+u32 circuit::sink_rt_early(u32 net_id, u32 gate_id){
+	struct gate &g = gate_list[gate_id];
+	if(g.inst == (u32)(-1)) return (g.r_time_early > g.fan_out && g.r_time_early != (u32)(-1)) ? g.r_time_early - g.fan_out : 0;
+	struct model_inst &inst = inst_list[g.inst];
+	u32 rt_early = 0;
+	vector<pair<u32, u32> >::const_iterator p = lower_bound(inst.in_pins.begin(), inst.in_pins.end(), make_pair(net_id, 0u));
+	for(; p != inst.in_pins.end() && p->first == net_id; p++)
+		rt_early = max(rt_early, inst.rt_early[p->second]);
+	return rt_early;
+}
+
+/*
+ * update_instance_arrival - computes the late and early arrival time at every output of a
+ * black-box instance from the arrival at its sources and the model delays, then adds the delay of
+ * the gate driving the output: its load inside the block plus the load of the net in the parent.
+ * The outputs are timed in out_order, so an output feeding another one is ready first.
+ * The gate itself gets the latest and the earliest of its output arrivals.
+ * @gate_id : the black-box gate, its fan in gates must have been timed
+ */
+void circuit::update_instance_arrival(u32 gate_id){
+	struct model_inst &inst = inst_list[gate_list[gate_id].inst];
+	timing_model &m = models[inst.model];
+	u32 _max = 0, _min = -1;
+
+	for(vector<u32>::const_iterator oi = m.out_order.begin(); oi != m.out_order.end(); oi++){
+		u32 o = *oi;
+		u32 at = 0, at_min = -1;
+		for(u32 s=0; s<m.num_inputs + m.num_outputs; s++){
+			size_t idx = (size_t)s * m.num_outputs + o;
+			if(m.delay[idx] == (u32)(-1)) continue;
+			u32 s_at = s < m.num_inputs ? net_at(inst.in_nets[s]) : inst.at[s - m.num_inputs];
+			u32 s_at_min = s < m.num_inputs ? net_at_min(inst.in_nets[s]) : inst.at_min[s - m.num_inputs];
+			at = max(at, s_at + m.delay[idx]);
+			at_min = min(at_min, s_at_min + m.delay_min[idx]);
+		}
+		if(at_min == (u32)(-1)) at_min = 0;		/* Output not driven by any input */
+		u32 d = (m.out_feed[o] == (u32)(-1)) ? m.out_load[o] + net_list[inst.out_nets[o]].load : 0;
+		inst.at[o] = at + d;
+		inst.at_min[o] = at_min + d;
+		_max = max(_max, inst.at[o]);
+		_min = min(_min, inst.at_min[o]);
+	}
+	gate_list[gate_id].a_time = _max;
+	gate_list[gate_id].a_time_min = (_min == (u32)(-1)) ? 0 : _min;
+}
+
+/*
+ * update_instance_required - computes the late and early required time at every input of a
+ * black-box instance from the required times of the gates its outputs drive, in the parent and
+ * through the block to later outputs. The gate itself gets the tightest required times and
+ * slacks over its outputs. The sinks are checked like in update_slack(): a sink or an output gate
+ * of the block that reaches no output of the circuit is an error unless break_nets() cut it off.
+ * @gate_id : the black-box gate, its fan out gates must have been timed
+ * @open : the gates allowed to stay unconstrained, see update_slack()
+ *
+ * Returns 0 on success, -1 if a gate is left without required time
+ */
+int circuit::update_instance_required(u32 gate_id, vector<char> &open){
+	struct model_inst &inst = inst_list[gate_list[gate_id].inst];
+	timing_model &m = models[inst.model];
+	u32 no = m.num_outputs;
+	vector<u32> req(no, -1), req_early(no, 0);	/* Required at the input of the gate driving each output */
+	u32 r_time = -1, r_time_early = 0, slack = -1, hold_slack = -1;
+
+	/* Required times at the outputs, latest output first */
+	for(vector<u32>::const_reverse_iterator oi = m.out_order.rbegin(); oi != m.out_order.rend(); oi++){
+		u32 o = *oi, onet = inst.out_nets[o];
+		u32 rt = -1, rt_early = 0;
+		bool driven = m.out_feed[o] != (u32)(-1);	/* A fed through input has no gate of its own */
+		for(list<u32>::const_iterator k = net_list[onet].gates.begin(); k != net_list[onet].gates.end(); k++){
+			struct gate &out_gate = gate_list[*k];
+			if(out_gate.inst == (u32)(-1) && ((out_gate.r_time == (u32)(-1) && !open[*k]) || out_gate.fan_out == (u32)(-1))){
+				cerr<<"Error calculating slack arrival time of gate index "<<out_gate.id<<" is -1\n";
+				return -1;
+			}
+			rt = min(rt, sink_rt(onet, *k));
+			rt_early = max(rt_early, sink_rt_early(onet, *k));
+			driven = true;
+		}
+		for(u32 b=0; b<no; b++){
+			size_t idx = (size_t)(m.num_inputs + o) * no + b;
+			if(m.delay[idx] == (u32)(-1)) continue;
+			if(req[b] != (u32)(-1)) rt = min(rt, req[b] - m.delay[idx]);
+			if(req_early[b] > m.delay_min[idx]) rt_early = max(rt_early, req_early[b] - m.delay_min[idx]);
+			driven = true;
+		}
+		if(!driven && !gate_list[gate_id].cut){
+			cerr<<"Error calculating slack, output "<<o<<" of model instance gate index "<<gate_id<<" drives nothing\n";
+			return -1;
+		}
+		u32 d = (m.out_feed[o] == (u32)(-1)) ? m.out_load[o] + net_list[onet].load : 0;
+		req[o] = (rt == (u32)(-1)) ? rt : rt - d;
+		req_early[o] = rt_early > d ? rt_early - d : 0;
+
+		r_time = min(r_time, rt);
+		r_time_early = max(r_time_early, rt_early);
+		if(rt != (u32)(-1)) slack = min(slack, rt - inst.at[o]);
+		hold_slack = min(hold_slack, inst.at_min[o] - rt_early);
+	}
+
+	/* Required times at the inputs */
+	for(u32 i=0; i<m.num_inputs; i++){
+		u32 rt = -1, rt_early = 0;
+		for(u32 o=0; o<no; o++){
+			size_t idx = (size_t)i * no + o;
+			if(m.delay[idx] == (u32)(-1)) continue;
+			if(req[o] != (u32)(-1)) rt = min(rt, req[o] - m.delay[idx]);
+			if(req_early[o] > m.delay_min[idx]) rt_early = max(rt_early, req_early[o] - m.delay_min[idx]);
+		}
+		inst.rt[i] = rt;
+		inst.rt_early[i] = rt_early;
+	}
+	gate_list[gate_id].r_time = r_time;
+	gate_list[gate_id].r_time_early = r_time_early;
+	gate_list[gate_id].slack = slack;
+	gate_list[gate_id].hold_slack = hold_slack;
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * This header file contains the abstract timing model used for hierarchical timing.
+ * A model is extracted from a timed circuit and keeps only its interface: the worst (and best)
+ * delay from every input to every output plus the boundary arrival and required times.
+ * The delay of a gate is its fan out, so the gates driving the outputs and the parent gates
+ * driving the inputs depend on the load seen across the boundary. The model keeps the internal
+ * load of every pin and leaves the output gate delays out of the matrix, an instance adds them
+ * back with its real load and times exactly like the flattened netlist.
+ * A parent netlist loads it with a MODEL(<name> = <file>) line and instantiates it as one
+ * black-box gate:
+ *     out1, out2 = <name>(in1, in2, in3)
+ * The nets are connected to the model inputs and outputs in their declaration order.
+ */
+
+#ifndef __MODEL_H
+#define __MODEL_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <utility>
+typedef unsigned int u32;
+
+/* Interface timing model of a sub-block */
+struct timing_model{
+	std::string			name;			/* Name of the block, informational */
+	u32					num_inputs;
+	u32					num_outputs;
+	u32					max_at;			/* Maximum arrival time of the block on its own */
+	std::vector<std::string>	input_names;	/* Input nets, in declaration order */
+	std::vector<std::string>	output_names;	/* Output nets, in declaration order */
+	std::vector<u32>	in_rt;			/* Required time at each input when timed on its own */
+	std::vector<u32>	in_rt_early;	/* Early required time at each input */
+	std::vector<u32>	in_load;		/* Gate pins driven by each input inside the block */
+	std::vector<u32>	out_at;			/* Arrival time at each output when timed on its own */
+	std::vector<u32>	out_at_min;		/* Early arrival time at each output */
+	std::vector<u32>	out_load;		/* Gate pins driven by each output inside the block */
+	std::vector<u32>	out_feed;		/* Input connected straight to each output, -1 if none */
+	std::vector<u32>	out_order;		/* Outputs in topological order of their driving gates */
+
+	/*
+	 * Delay matrices indexed by source * num_outputs + output, -1 if there is no path. Sources 0 to
+	 * num_inputs-1 are the inputs, source num_inputs + a is output a feeding logic inside the block.
+	 * A signal on source s at time t reaches the input of the gate driving output o at t + delay,
+	 * without passing through the gate driving another output. That gate adds its fan out:
+	 * out_load plus the load on the output net in the parent. An output fed straight by input i
+	 * has delay 0 from i and no gate.
+	 */
+	std::vector<u32>	delay;			/* Longest path delay */
+	std::vector<u32>	delay_min;		/* Shortest path delay */
+
+	timing_model():num_inputs(0), num_outputs(0), max_at(0){}
+};
+
+/* A black-box gate instantiating a timing_model in a parent circuit */
+struct model_inst{
+	u32					model;			/* Index into circuit::models */
+	u32					gate;			/* Id of the black-box gate */
+	std::vector<u32>	in_nets;		/* Net connected to each model input */
+	std::vector<u32>	out_nets;		/* Net connected to each model output */
+
+	/* (net, pin) pairs sorted by net, to find the pins of a net with a binary search */
+	std::vector<std::pair<u32, u32> >	in_pins;
+	std::vector<std::pair<u32, u32> >	out_pins;
+
+	/* Timing of the instance pins indexed by pin, updated with the rest of the circuit */
+	std::vector<u32>	at;				/* Arrival time at each output */
+	std::vector<u32>	at_min;			/* Early arrival time at each output */
+	std::vector<u32>	rt;				/* Required time at each input */
+	std::vector<u32>	rt_early;		/* Early required time at each input */
+
+	model_inst():model(-1), gate(-1){}
+};
+
+class circuit;
+
+/* For description of these function see model.cpp */
+int extract_model(class circuit &c, std::list<u32> &slist, u32 max_at, timing_model &m, u32 threads);
+int write_model(timing_model &m, const char *file);
+int read_model(const char *file, timing_model &m);
+
+#endif
@@ -1,4 +1,5 @@
 #include "netlist.h"
+#include "instream.h"
 #include <iostream>
 #include <fstream>
 #include <cstring>
@@ -10,9 +11,15 @@ using namespace std;
 
 
 char *trim(char *);
+static void split_names(const string &str, vector<string> &names);
 
 /* parse_input - takes a filename which contains the complete circuit/netlist representation and 
  * generates the corresponding data structures for graph representation.
+ * The file may be plain or gzip/zstd compressed, it is read and decompressed by the
+ * instream reader thread while the lines are parsed here.
+ * Abstract timing models are loaded with MODEL(<name> = <file>) lines, a relative file name is
+ * taken from the directory of the netlist. See model.h for the instance syntax.
+ * Malformed lines and nets that are used but never driven are reported as errors.
  * 
  * @file : the input file name containing complete circuit description
  * 
@@ -24,16 +31,25 @@ u32 circuit::parse_input(const char *file){
 	char *str, *str_ptr, *token;
 	string line;
 	u32 inputs =0, outputs=0, gates=0;
+	string dir(file);
+	dir = (dir.rfind('/') == string::npos) ? "" : dir.substr(0, dir.rfind('/') + 1);
 	
 	/* Open the input file and check for error */
-	ifstream in_file(file);
-	if(!in_file.is_open()){
+	instream in_file;
+	if(in_file.open(file) != 0){
 		cerr<<"Can't open input file: "<<file<<endl;
 		return 1;
 	}
 	
+	/* Reports a line that can't be parsed, the circuit is left partially built */
+	auto malformed = [&](const char *what){
+		cerr<<what<<": "<<line<<endl;
+		delete []str_ptr;
+		return 1;
+	};
+	
 	/* Read lines from the file */
-	while(getline(in_file, line)){
+	while(in_file.getline(line)){
 		
 		/* Leave empty lines */
 		if(line=="") continue;				
@@ -53,37 +69,69 @@ u32 circuit::parse_input(const char *file){
 
 		/* Now we got rid of all empty and blank lines */
 		/* Extract the first tokens from the input line */
+		if(strchr(in_seps, *str) != NULL) return malformed("Malformed line");
 		token = strtok( str, in_seps );
+		if(token == NULL) return malformed("Malformed line");
 		token=trim(token);
 	
 		if(strncmp(token,"INPUT",6)==0){				/* An input net is found */
 			token = strtok( NULL, ")" );
+			if(token == NULL) return malformed("Error Adding Input Gate after parsing");
 			token=trim(token);
 			string t(token);
-			if(add_input_edge(t) != 0){
-				cerr<<"Error Adding Input Gate after parsing\n";
-				exit(-1);
-			}
+			if(add_input_edge(t) != 0) return malformed("Error Adding Input Gate after parsing");
 			++inputs;
 		}else if(strncmp(token,"OUTPUT",7)==0){ 		/* An output net if found */
 				token = strtok( NULL, ")" );
+				if(token == NULL) return malformed("Error Adding Output Gate after parsing");
 				token=trim(token);
 				string t(token);
-				if(add_output_edge(t) != 0){
-					cerr<<"Error Adding Output Gate after parsing\n";
-					exit(-1);
-				}
+				if(add_output_edge(t) != 0) return malformed("Error Adding Output Gate after parsing");
 			++outputs;
+		}else if(strncmp(token,"MODEL",6)==0){ 		/* An abstract model to load */
+				token = strtok( NULL, ")" );
+				char *eq = (token == NULL) ? NULL : strchr(token, '=');
+				if(eq == NULL) return malformed("Expected MODEL(<name> = <file>)");
+				*eq = 0;
+				string name(trim(token)), path(trim(eq + 1));
+				if(!path.empty() && path[0] != '/') path = dir + path;
+				if(add_model(name, path) != 0) return malformed("Can't load model");
 		}else{											
 			/* if neither input nor output then gate description is found */
-				
-				/* find an entry in net_list for this output net of the gate */
 				string t(token);
-				u32 onet = add_net(INTERNAL_NET, t);
+				if(t.empty()) return malformed("Missing output net");
 
 				/* Getting the gate name (type) */
 				token=strtok(NULL, "(");
+				if(token == NULL) return malformed("Missing gate type");
 				token=trim(token);
+				if(*token == 0) return malformed("Missing gate type");
+
+				/* A black-box instance of a model, with one or more output nets */
+				map<string, u32>::const_iterator mi = model_map.find(token);
+				if(mi != model_map.end()){
+					vector<string> outs, ins;
+					split_names(t, outs);
+					if((token = strtok( NULL, ")" )) != NULL) split_names(token, ins);
+					timing_model &m = models[mi->second];
+					if(outs.size() != m.num_outputs || ins.size() != m.num_inputs){
+						cerr<<"Instance of model "<<mi->first<<" needs "<<m.num_outputs<<" outputs and "
+							<<m.num_inputs<<" inputs\n";
+						return malformed("Wrong number of pins");
+					}
+					vector<u32> onets, inets;
+					for(vector<string>::iterator o = outs.begin(); o != outs.end(); o++)
+						onets.push_back(add_net(INTERNAL_NET, *o));
+					for(vector<string>::iterator in = ins.begin(); in != ins.end(); in++)
+						inets.push_back(add_net(INTERNAL_NET, *in));
+					add_model_instance(mi->second, onets, inets);
+					++gates;
+					delete []str_ptr;
+					continue;
+				}
+				
+				/* find an entry in net_list for this output net of the gate */
+				u32 onet = add_net(INTERNAL_NET, t);
 
 				/* Add an entry for this gate */
 				u32 _gate = add_gate(get_gate_type(token));
@@ -99,8 +147,9 @@ u32 circuit::parse_input(const char *file){
 				/* Now the tokens are separated by comma, last token will either have a ')' character or some spaces followed by ')' at the end*/
 				while((token = strtok( NULL, "," )) != NULL ){
 					token=trim(token);
-					if(token[strlen(token)-1]==')') token[strlen(token)-1]=0;
+					if(*token != 0 && token[strlen(token)-1]==')') token[strlen(token)-1]=0;
 					token=trim(token);
+					if(*token == 0) return malformed("Empty input net");
 
 					/* Get an edge for this net and add the gate to its gates list*/
 					string t(token);
@@ -113,7 +162,18 @@ u32 circuit::parse_input(const char *file){
 		}
 		delete []str_ptr;
 	}
-	in_file.close();
+	if(in_file.close() != 0){
+		cerr<<"Error while reading input file: "<<file<<endl;
+		return 1;
+	}
+	
+	/* A net without driver would be timed from a gate that does not exist */
+	for(vector<struct net>::const_iterator i = net_list.begin(); i != net_list.end(); i++){
+		if(i->driving_gate >= num_gates){
+			cerr<<"Net "<<get_edge_name(i->id)<<" is used but never driven\n";
+			return 1;
+		}
+	}
 	return 0;
 }
 
@@ -323,22 +383,70 @@ int circuit::add_input_edge(string &str){
 }
 
 /*
- * update_fan_out - updates the fanout of all the gates once the adjacency lists have been build.
+ * update_fan_out - updates the load of all the nets and the fanout of all the gates once the
+ * adjacency lists have been build. A model input drives as many pins as the net it replaced inside
+ * the block, so the gate driving it gets the same delay as in the flattened netlist.
  * Returns 0 on success
  */
 int circuit::update_fan_out(){
+	for(vector<struct net>::iterator i = net_list.begin(); i != net_list.end(); i++)
+		i->load = i->gates.size();
+	for(vector<struct model_inst>::const_iterator i = inst_list.begin(); i != inst_list.end(); i++)
+		for(u32 p=0; p<i->in_nets.size(); p++)
+			net_list[i->in_nets[p]].load += models[i->model].in_load[p] - 1;	/* The instance is one of the gates */
+
+	/*
+	 * An input wired straight to an output is one net in the flattened netlist, so the input also
+	 * drives the load of the output net. Chains of such instances settle in one pass per instance.
+	 */
+	vector<pair<u32, u32> > feeds;		/* (input net, output net) */
+	for(vector<struct model_inst>::const_iterator i = inst_list.begin(); i != inst_list.end(); i++)
+		for(u32 o=0; o<i->out_nets.size(); o++)
+			if(models[i->model].out_feed[o] != (u32)(-1))
+				feeds.push_back(make_pair(i->in_nets[models[i->model].out_feed[o]], i->out_nets[o]));
+	if(!feeds.empty()){
+		vector<u32> base(num_nets), load(num_nets);
+		for(u32 n=0; n<num_nets; n++) base[n] = net_list[n].load;
+		for(u32 pass = 0, changed = 1; changed && pass <= feeds.size(); pass++){	/* More passes only in a loop */
+			load = base;
+			for(vector<pair<u32, u32> >::const_iterator f = feeds.begin(); f != feeds.end(); f++)
+				load[f->first] += net_list[f->second].load;
+			changed = 0;
+			for(u32 n=0; n<num_nets; n++){
+				if(net_list[n].load != load[n]) changed = 1;
+				net_list[n].load = load[n];
+			}
+		}
+	}
 	
 	/* for each gate */
 	for(vector<struct gate>::iterator i = gate_list.begin(); i != gate_list.end(); i++){
 		/* Iterate over the edges that this gate drives, for nets that don't have any out edges (output gate) this loop wont run */
 		for(list<u32>::const_iterator j = i->nets.begin(); j != i->nets.end(); j++){
 			/* add the number of gates each edge drives to fan out */
-			i->fan_out += net_list[*j].gates.size();
+			i->fan_out += net_list[*j].load;
 		}
 	}
 	return 0;
 }
 
+/*
+ * gate_successors - flattens the gate to gate edges into a CSR array. The successors of gate g are
+ * succ[off[g]] .. succ[off[g+1]-1], a gate appears once per net and pin connecting it to g.
+ * @off : receives num_gates+1 offsets
+ * @succ : receives the successor gate ids
+ */
+void circuit::gate_successors(vector<u32> &off, vector<u32> &succ){
+	off.assign(num_gates + 1, 0);
+	succ.clear();
+	for(u32 g=0; g<num_gates; g++){
+		off[g] = succ.size();
+		for(list<u32>::const_iterator j = gate_list[g].nets.begin(); j != gate_list[g].nets.end(); j++)
+			succ.insert(succ.end(), net_list[*j].gates.begin(), net_list[*j].gates.end());
+	}
+	off[num_gates] = succ.size();
+}
+
 /*
  * This function takes the edge numeric identifier and returns the name/label of the edge
  * read from the input file.
@@ -353,6 +461,35 @@ string circuit::get_edge_name(unsigned int id){
 	
 }
 
+/*
+ * net_names - names every net at once, for callers that need many names (get_edge_name() searches
+ * the whole edge_map for each one).
+ * @names : receives a pointer to the name of each net indexed by net id, valid while edge_map is unchanged
+ */
+void circuit::net_names(vector<const string *> &names){
+	names.assign(num_nets, (const string *)NULL);
+	for(map<string, u32>::const_iterator ci = edge_map.begin(); ci != edge_map.end(); ci++)
+		names[ci->second] = &ci->first;
+}
+
+/*
+ * split_names - splits a comma separated list of net names and trims the spaces around them
+ * @str : the list
+ * @names : receives the non empty names
+ */
+static void split_names(const string &str, vector<string> &names){
+	size_t start = 0;
+	while(start <= str.size()){
+		size_t end = str.find(',', start);
+		if(end == string::npos) end = str.size();
+		size_t first = str.find_first_not_of(" \t\r\n", start);
+		size_t last = str.find_last_not_of(" \t\r\n", end - 1);
+		if(first != string::npos && first < end && last != string::npos && last >= first)
+			names.push_back(str.substr(first, last - first + 1));
+		start = end + 1;
+	}
+}
+
 /* 
  * trims whitespaces from either side of the token.
  * @token : token to be trimmed
@@ -439,22 +576,27 @@ int circuit::topo_sort(list<u32> & slist){
 			}
 		}
 	}
-	if(slist.size() != num_gates) return -1;
 	delete[] fanin;
+	if(slist.size() != num_gates) return -1;	/* Some gates are in or behind a loop, see find_loops() */
 	return 0;
 }
 /* 
  * This function calculates the arrival time of gates given a topological ordering of gates.
- * The arrival time here is the time at which the output will appear at the output of the gate
+ * The arrival time here is the time at which the output will appear at the output of the gate.
+ * The latest (a_time) and the earliest (a_time_min) arrival times are propagated in the same sweep.
  * @param slist : topologically sorted ordering of gates
  * @param max_at : the maximum arrival time over all the gates will be stored in this variable
+ * @param min_at : the minimum early arrival time over the output gates will be stored in this variable,
+ *                 it is used as the hold requirement at the outputs
  * 
- * Returns 0 on success
+ * Returns 0 on success, -1 if a gate is reached before its fan in (inconsistent order or fanouts)
  */
-int circuit::update_arrival_time(list<u32> &slist, u32 &max_at){
+int circuit::update_arrival_time(list<u32> &slist, u32 &max_at, u32 &min_at){
 	if(slist.empty()) return -1;
 	max_at = 0;
+	min_at = -1;
 	u32 in_type = get_gate_type("INPUT");
+	u32 out_type = get_gate_type("OUTPUT");
 	
 	/* Pick up the gates one by one from topological sorting */
 	for(list<u32>::const_iterator i = slist.begin(); i != slist.end(); i++){
@@ -463,69 +605,108 @@ int circuit::update_arrival_time(list<u32> &slist, u32 &max_at){
 		if(gate_list[*i].type == in_type){
 			if(gate_list[*i].fan_out == (u32)(-1)){
 					cerr<<"Error fanout of gate index "<<gate_list[*i].id<<" is -1\n";
-					exit(-1);
+					return -1;
 			}
 			gate_list[*i].a_time = gate_list[*i].fan_out;
+			gate_list[*i].a_time_min = gate_list[*i].fan_out;
 			max_at = max(max_at, gate_list[*i].a_time);
 			continue; 
 		}
 		
+		/* Black-box instances time each of their outputs from the model */
+		if(gate_list[*i].inst != (u32)(-1)){
+			update_instance_arrival(*i);
+			max_at = max(max_at, gate_list[*i].a_time);
+			continue;
+		}
+		
 		/* For all other gates */
 		u32 _max = 0;
+		u32 _min = gate_list[*i].in_nets.empty() ? 0 : -1;
 		
-		/* Find the in gates find the maximum arrival time and add the gate_delay of this gate */
+		/* Find the in gates find the maximum and minimum arrival time and add the gate_delay of this gate */
 		for(list<u32>::const_iterator j = gate_list[*i].in_nets.begin(); j != gate_list[*i].in_nets.end(); j++){
 			//cout<<*i<<" driven by gates "<<net_list[*j].driving_gate<<endl;
-			if(gate_list[net_list[*j].driving_gate].a_time == (u32)(-1)){
+			struct gate &in_gate = gate_list[net_list[*j].driving_gate];
+			if(in_gate.a_time == (u32)(-1)){
 					cerr<<"Error fanout of gate index "<<gate_list[*i].id<<" is -1\n";
-					exit(-1);
+					return -1;
 			}
-			_max = max(_max, gate_list[net_list[*j].driving_gate].a_time);
+			_max = max(_max, net_at(*j));
+			_min = min(_min, net_at_min(*j));
 		}
 		gate_list[*i].a_time = _max + gate_list[*i].fan_out;
+		gate_list[*i].a_time_min = _min + gate_list[*i].fan_out;
 		max_at = max(max_at, gate_list[*i].a_time);
+		if(gate_list[*i].type == out_type) min_at = min(min_at, gate_list[*i].a_time_min);
 		//cout<<"Max delay @ input : "<<max_at<<endl;
 	}
 	return 0;
 }
 
 /*
- * This function updates the slack and required_time of all the gates
+ * This function updates the slack and required_time of all the gates, for the setup (late) and the
+ * hold (early) check in the same reverse sweep.
+ * The late required time is the minimum over the fanouts, the early required time is the maximum
+ * over the fanouts. Early required times below 0 are clamped to 0 since no arrival can be earlier.
+ * A gate that reaches no output has no required time, which is an error unless it was cut off by
+ * break_nets(): such gates and the gates feeding only them are left unconstrained, all their
+ * required times and slacks are -1.
  * @param slist : topologically sorted list of gates
  * @max_rt : maximum required time at the output gates
+ * @min_rt : earliest allowed arrival time at the output gates
  * 
- * returns 0 on success
+ * returns 0 on success, -1 if a gate is reached before its fan out
  */
-int circuit::update_slack(list<u32> &slist, u32 & max_rt){
+int circuit::update_slack(list<u32> &slist, u32 & max_rt, u32 & min_rt){
 	if(slist.empty()) return -1;
 	u32 out_type = get_gate_type("OUTPUT");
+	vector<char> open(num_gates, 0);		/* Gates allowed to stay unconstrained */
 	
 	for(list<u32>::reverse_iterator i = slist.rbegin(); i != slist.rend(); i++){
 		
-		/* For output gates the required time is equal to max_rt */
+		/* For output gates the required time is equal to max_rt, min_rt for the hold check */
 		if(gate_list[*i].type == out_type){
 			gate_list[*i].r_time = max_rt;
+			gate_list[*i].r_time_early = min_rt;
 			if(gate_list[*i].a_time == (u32)(-1)){
 					cerr<<"Error calculating slack arrival time of gate index "<<gate_list[*i].id<<" is -1\n";
-					exit(-1);
+					return -1;
 			}
 			gate_list[*i].slack = gate_list[*i].r_time - gate_list[*i].a_time;
+			gate_list[*i].hold_slack = gate_list[*i].a_time_min - gate_list[*i].r_time_early;
+			continue;
+		}
+		
+		/* Black-box instances get the required times of each input from the model */
+		if(gate_list[*i].inst != (u32)(-1)){
+			if(update_instance_required(*i, open) != 0)
+				return -1;
 			continue;
 		}
 		//cout<<*i<<" driving ";
 		u32 _min = -1; /* This is positive infinity for unsigned */
+		u32 _max = 0;
+		bool driven = false;		/* Drives at least one gate */
 		for(list<u32>::const_iterator j = gate_list[*i].nets.begin(); j != gate_list[*i].nets.end(); j++){
 			for(list<u32>::const_iterator k = net_list[*j].gates.begin(); k != net_list[*j].gates.end(); k++){
 				//cout<<*k<<" ";
-				if(gate_list[*k].r_time == (u32)(-1) || gate_list[*k].fan_out == (u32)(-1)){
-					cerr<<"Error calculating slack arrival time of gate index "<<gate_list[*k].id<<" is -1\n";
-					exit(-1);
+				struct gate &out_gate = gate_list[*k];
+				if(out_gate.inst == (u32)(-1) && ((out_gate.r_time == (u32)(-1) && !open[*k]) || out_gate.fan_out == (u32)(-1))){
+					cerr<<"Error calculating slack arrival time of gate index "<<out_gate.id<<" is -1\n";
+					return -1;
 			}
-				_min = min(_min, (gate_list[*k].r_time - gate_list[*k].fan_out));
+				_min = min(_min, sink_rt(*j, *k));
+				_max = max(_max, sink_rt_early(*j, *k));
+				driven = true;
 			}
 		}
 		gate_list[*i].r_time = _min;
-		gate_list[*i].slack = gate_list[*i].r_time - gate_list[*i].a_time;
+		open[*i] = gate_list[*i].cut || (driven && _min == (u32)(-1));
+		bool unconstrained = open[*i] && _min == (u32)(-1);
+		gate_list[*i].slack = unconstrained ? _min : gate_list[*i].r_time - gate_list[*i].a_time;
+		gate_list[*i].r_time_early = unconstrained ? _min : _max;
+		gate_list[*i].hold_slack = unconstrained ? _min : gate_list[*i].a_time_min - gate_list[*i].r_time_early;
 		//cout<<" Min time is "<<_min;
 		//cout<<endl;
 	} 
@@ -11,11 +11,13 @@
 #include <list>
 #include <map>
 #include <limits>
+#include <ostream>
+#include "model.h"
 using namespace std;
 typedef unsigned int u32;
 
 /* Number and Type of gates and nets. */
-#define NUM_TYPE_GATES 9
+#define NUM_TYPE_GATES 10			/* Including the MODEL type of black-box instances */
 #define NUM_TYPE_NETS 6
 enum net_t {INPUT_NET, OUTPUT_NET, IO_NET, HYPEREDGE, INTERNAL_NET, UNDEFINED}; /* Types of nets/edges in circuit */
 
@@ -28,18 +30,23 @@ struct gate{
 	u32 				type;		/* Type of the gate */
 	u32			 		fan_in;		/* Fan in for this gate */
 	u32			 		fan_out; 	/* Fan out for this gate, also the delay */
-	u32					a_time;		/* Arrival Time */
+	u32					a_time;		/* Arrival Time, latest over all paths */
 	u32					r_time;		/* Required time */
 	u32					slack;		/* Slack */
+	u32					a_time_min;	/* Earliest arrival time over all paths */
+	u32					r_time_early;	/* Earliest allowed arrival time for the hold check */
+	u32					hold_slack;	/* Hold slack, a_time_min - r_time_early */
 	bool				flag;		/* Flag for misc purposes */
+	u32					inst;		/* Index into inst_list for black-box model instances, -1 otherwise */
+	bool				cut;		/* Drives a net opened by break_nets(), may be left without a required time */
 
 	std::list<u32> 	nets;	/* List of output edges from this gate. By using sizeof() operator we can get the number of output edges */
 	std::list<u32>  in_nets; /* List of input edges to this gate. */
 	
 	/* Constructor for initializing all values */
-	gate():id(-1), type(-1), fan_in(0), fan_out(-1), a_time(-1), r_time(-1), slack (-1), flag(false), nets(std::list<u32> ()), in_nets(std::list<u32> ()){}
+	gate():id(-1), type(-1), fan_in(0), fan_out(-1), a_time(-1), r_time(-1), slack (-1), a_time_min(-1), r_time_early(-1), hold_slack(-1), flag(false), inst(-1), cut(false), nets(std::list<u32> ()), in_nets(std::list<u32> ()){}
 	gate(u32 id_val, u32 type_val, u32 fanin, u32 fanout, std::list<u32> &val, std::list<u32> &in_val):
-							id(id_val), type(type_val), fan_in(fanin), fan_out(fanout), a_time(-1), r_time(-1), slack(-1), flag(false), nets(val), in_nets(in_val){}
+							id(id_val), type(type_val), fan_in(fanin), fan_out(fanout), a_time(-1), r_time(-1), slack(-1), a_time_min(-1), r_time_early(-1), hold_slack(-1), flag(false), inst(-1), cut(false), nets(val), in_nets(in_val){}
 };
 	
 /* Structure for nets of the circuit or edges of the graph */
@@ -48,14 +55,15 @@ struct net{
 	int					delay;		/* delay of this edge */
 	net_t				type;		/* Type of net. See net types above */
 	u32					driving_gate;	/* Id of the gate that drives this net */
+	u32					load;		/* Gate pins driven, a model input counts its inner load. See update_fan_out() */
 	
 	std::list<u32>	gates;	/* Gates driven by this net */
 									/* Number of gates driven by this net can be found by the size of this list */
 									
 	/* Constructor for initializing all values */
-	net():id(std::numeric_limits<u32>::max()), delay(0), type(UNDEFINED), driving_gate(-1), gates(std::list<u32>()){}
+	net():id(std::numeric_limits<u32>::max()), delay(0), type(UNDEFINED), driving_gate(-1), load(0), gates(std::list<u32>()){}
 	net(u32 &id_val, int &delay_val, net_t &type_val, list<u32> &val):id(id_val), 
-												 delay(delay_val), type(type_val),  driving_gate(-1), gates(val){}
+												 delay(delay_val), type(type_val),  driving_gate(-1), load(0), gates(val){}
 };
 
 /* 
@@ -90,6 +98,10 @@ class circuit{
 	std::map<std::string, u32> edge_map;	/* Maps the name of the edges with the corresponding index in edges adjacency list */
 	std::map<std::string, u32> gate_t;		/* Maps the name of the gates with there types ( an integer for easy calculation ) */
 
+	std::vector<struct timing_model> models;	/* Abstract models loaded with MODEL(...) lines */
+	std::map<std::string, u32> model_map;		/* Maps the name given in MODEL(...) to the index in models */
+	std::vector<struct model_inst> inst_list;	/* Black-box instances of the models */
+
 	public:
 	/* Constructor for initializing all values to zero */
 	circuit():num_gates(0), num_nets(0){
@@ -109,12 +121,26 @@ class circuit{
 	int add_output_edge(string &str);
 	int update_same_faninout();
 	string get_edge_name(unsigned int id);
+	void net_names(vector<const string *> &names);
 	u32 get_gate_type(string str);
 	string get_gate_name(u32 id);
 	
+	void gate_successors(vector<u32> &, vector<u32> &);
 	int topo_sort(list<u32> &);
-	int update_arrival_time(list<u32> &, u32 &);
-	int update_slack(list<u32> &, u32 &);
+	u32 find_loops(vector<vector<u32> > &);
+	void report_loops(vector<vector<u32> > &, ostream &);
+	int break_nets(vector<string> &names);
+	int update_arrival_time(list<u32> &, u32 &, u32 &);
+	int update_slack(list<u32> &, u32 &, u32 &);
+
+	int add_model(string &name, string &file);
+	u32 add_model_instance(u32 model, vector<u32> &outs, vector<u32> &ins);
+	u32 net_at(u32 net_id);
+	u32 net_at_min(u32 net_id);
+	u32 sink_rt(u32 net_id, u32 gate_id);
+	u32 sink_rt_early(u32 net_id, u32 gate_id);
+	void update_instance_arrival(u32 gate_id);
+	int update_instance_required(u32 gate_id, vector<char> &open);
 };
 
 #endif
@@ -0,0 +1,290 @@
+#include "result.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+/* Rounds a file offset up to the alignment of the sections */
+static unsigned long long align8(unsigned long long off){
+	return (off + 7) & ~7ULL;
+}
+
+/* Checks that an array of n u32 at offset off is aligned and lies inside a file of the given size */
+static bool section_ok(unsigned long long off, unsigned long long n, unsigned long long size){
+	return off % 4 == 0 && off <= size && n <= (size - off) / 4;
+}
+
+/* Writes zero bytes until the stream reaches offset off */
+static void pad_to(ofstream &out, unsigned long long off){
+	static const char zero[8] = {0};
+	unsigned long long pos = (unsigned long long)out.tellp();
+	if(off > pos) out.write(zero, off - pos);
+}
+
+/*
+ * write_binary_result - writes the timing of the circuit in the binary format described in result.h
+ * @c : the circuit, after update_arrival_time() and update_slack() were called
+ * @max_at : the maximum arrival time returned by update_arrival_time()
+ * @min_at : the minimum early arrival time returned by update_arrival_time()
+ * @file : the output file name
+ * @names : also write the name of the net driven by each gate
+ *
+ * Returns 0 on success
+ */
+int write_binary_result(class circuit &c, u32 max_at, u32 min_at, const char *file, bool names){
+	vector<u32> inputs, outputs;
+	vector<u32> a_time, r_time, slack;
+	vector<u32> a_time_min, r_time_early, hold_slack;
+	vector<u32> name_off;
+	string blob;
+	u32 in_type = c.get_gate_type("INPUT");
+	u32 out_type = c.get_gate_type("OUTPUT");
+
+	a_time.reserve(c.num_gates);
+	r_time.reserve(c.num_gates);
+	slack.reserve(c.num_gates);
+	a_time_min.reserve(c.num_gates);
+	r_time_early.reserve(c.num_gates);
+	hold_slack.reserve(c.num_gates);
+	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++){
+		if(i->type == in_type) inputs.push_back(i->id);
+		if(i->type == out_type) outputs.push_back(i->id);
+		a_time.push_back(i->a_time);
+		r_time.push_back(i->r_time);
+		slack.push_back(i->slack);
+		a_time_min.push_back(i->a_time_min);
+		r_time_early.push_back(i->r_time_early);
+		hold_slack.push_back(i->hold_slack);
+	}
+
+	if(names){
+		vector<const string *> net_name;
+		c.net_names(net_name);
+
+		name_off.reserve(c.num_gates + 1);
+		for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++){
+			name_off.push_back(blob.size());
+			const list<u32> &nets = i->nets.empty() ? i->in_nets : i->nets;
+			if(!nets.empty() && net_name[nets.front()] != NULL)
+				blob += *net_name[nets.front()];
+		}
+		name_off.push_back(blob.size());
+	}
+
+	/* Lay out the sections */
+	result_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, RESULT_MAGIC, 4);
+	hdr.version = RESULT_VERSION;
+	hdr.byte_order = RESULT_BYTE_ORDER;
+	hdr.flags = names ? RESULT_HAS_NAMES : 0;
+	hdr.num_gates = c.num_gates;
+	hdr.max_at = max_at;
+	hdr.min_at = min_at;
+	hdr.num_inputs = inputs.size();
+	hdr.num_outputs = outputs.size();
+	hdr.inputs_off = align8(sizeof(hdr));
+	hdr.outputs_off = align8(hdr.inputs_off + 4ULL * hdr.num_inputs);
+	hdr.a_time_off = align8(hdr.outputs_off + 4ULL * hdr.num_outputs);
+	hdr.r_time_off = align8(hdr.a_time_off + 4ULL * hdr.num_gates);
+	hdr.slack_off = align8(hdr.r_time_off + 4ULL * hdr.num_gates);
+	hdr.a_time_min_off = align8(hdr.slack_off + 4ULL * hdr.num_gates);
+	hdr.r_time_early_off = align8(hdr.a_time_min_off + 4ULL * hdr.num_gates);
+	hdr.hold_slack_off = align8(hdr.r_time_early_off + 4ULL * hdr.num_gates);
+	hdr.file_size = hdr.hold_slack_off + 4ULL * hdr.num_gates;
+	if(names){
+		hdr.name_off_off = align8(hdr.file_size);
+		hdr.names_off = hdr.name_off_off + 4ULL * name_off.size();
+		hdr.file_size = hdr.names_off + blob.size();
+	}
+
+	ofstream out(file, ios::out | ios::binary | ios::trunc);
+	if(!out.is_open()){
+		cerr<<"Can't open output file for writing\n";
+		return -1;
+	}
+	out.write((const char *)&hdr, sizeof(hdr));
+	pad_to(out, hdr.inputs_off);	out.write((const char *)inputs.data(), 4 * inputs.size());
+	pad_to(out, hdr.outputs_off);	out.write((const char *)outputs.data(), 4 * outputs.size());
+	pad_to(out, hdr.a_time_off);	out.write((const char *)a_time.data(), 4 * a_time.size());
+	pad_to(out, hdr.r_time_off);	out.write((const char *)r_time.data(), 4 * r_time.size());
+	pad_to(out, hdr.slack_off);		out.write((const char *)slack.data(), 4 * slack.size());
+	pad_to(out, hdr.a_time_min_off);	out.write((const char *)a_time_min.data(), 4 * a_time_min.size());
+	pad_to(out, hdr.r_time_early_off);	out.write((const char *)r_time_early.data(), 4 * r_time_early.size());
+	pad_to(out, hdr.hold_slack_off);	out.write((const char *)hold_slack.data(), 4 * hold_slack.size());
+	if(names){
+		pad_to(out, hdr.name_off_off);
+		out.write((const char *)name_off.data(), 4 * name_off.size());
+		out.write(blob.data(), blob.size());
+	}
+	out.close();
+	if(out.fail()){
+		cerr<<"Error while writing output file\n";
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * write_text_result - writes the text .out format: the maximum arrival time, the number and ids
+ * of the input gates, the number and ids of the output gates and one "id a_time slack a_time_min hold_slack"
+ * line per gate.
+ * @out : the output stream
+ * @max_at : maximum arrival time
+ * @inputs, @outputs : ids of the input and output gates
+ * @a_time, @slack : late arrival time and setup slack, indexed by gate id
+ * @a_time_min, @hold_slack : early arrival time and hold slack, indexed by gate id
+ * @num_gates : length of the arrays
+ */
+void write_text_result(ostream &out, u32 max_at, const vector<u32> &inputs, const vector<u32> &outputs,
+					   const u32 *a_time, const u32 *slack, const u32 *a_time_min, const u32 *hold_slack, u32 num_gates){
+	out<<max_at<<"\n";			/* maximum delay over all nodes */
+
+	out<<inputs.size()<<" ";
+	for(vector<u32>::const_iterator i = inputs.begin(); i != inputs.end(); i++)
+		out<<*i<<" ";
+	out<<"\n";
+
+	out<<outputs.size()<<" ";
+	for(vector<u32>::const_iterator i = outputs.begin(); i != outputs.end(); i++)
+		out<<*i<<" ";
+	out<<"\n";
+
+	for(u32 i=0; i<num_gates; i++)
+		out<<i<<" "<<a_time[i]<<" "<<slack[i]<<" "<<a_time_min[i]<<" "<<hold_slack[i]<<"\n";
+	out<<"\n";
+}
+
+/*
+ * write_text_result - writes the text .out format for a timed circuit
+ * @out : the output stream
+ * @c : the circuit, after update_arrival_time() and update_slack() were called
+ * @max_at : the maximum arrival time returned by update_arrival_time()
+ */
+void write_text_result(ostream &out, class circuit &c, u32 max_at){
+	vector<u32> inputs, outputs, a_time, slack, a_time_min, hold_slack;
+	u32 in_type = c.get_gate_type("INPUT");
+	u32 out_type = c.get_gate_type("OUTPUT");
+
+	for(vector<struct gate>::const_iterator i = c.gate_list.begin(); i != c.gate_list.end(); i++){
+		if(i->type == in_type) inputs.push_back(i->id);
+		if(i->type == out_type) outputs.push_back(i->id);
+		a_time.push_back(i->a_time);
+		slack.push_back(i->slack);
+		a_time_min.push_back(i->a_time_min);
+		hold_slack.push_back(i->hold_slack);
+	}
+	write_text_result(out, max_at, inputs, outputs, a_time.data(), slack.data(), a_time_min.data(), hold_slack.data(), c.num_gates);
+}
+
+/*
+ * convert_result - converts a binary result file into the text .out format
+ * @bin_file : the binary result file
+ * @text_file : the text file to write
+ *
+ * Returns 0 on success
+ */
+int convert_result(const char *bin_file, const char *text_file){
+	timing_result r;
+	if(r.open(bin_file) != 0)
+		return -1;
+
+	ofstream fout(text_file);
+	if(!fout.is_open()){
+		cerr<<"Can't open output file for writing\n";
+		return -1;
+	}
+	vector<u32> inputs(r.inputs(), r.inputs() + r.num_inputs());
+	vector<u32> outputs(r.outputs(), r.outputs() + r.num_outputs());
+	write_text_result(fout, r.max_at(), inputs, outputs, r.a_times(), r.slacks(), r.a_times_min(), r.hold_slacks(), r.num_gates());
+	fout.close();
+	if(fout.fail()){
+		cerr<<"Error while writing output file\n";
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * open - maps a binary result file read only and validates its header
+ * @file : the binary result file
+ *
+ * Returns 0 on success
+ */
+int timing_result::open(const char *file){
+	struct stat st;
+	close();
+
+	int fd = ::open(file, O_RDONLY);
+	if(fd < 0){
+		cerr<<"Can't open result file: "<<file<<endl;
+		return -1;
+	}
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(result_header)){
+		cerr<<"Not a binary result file: "<<file<<endl;
+		::close(fd);
+		return -1;
+	}
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);		/* The mapping stays valid */
+	if(p == MAP_FAILED){
+		cerr<<"Can't map result file: "<<file<<endl;
+		return -1;
+	}
+	base = (const char *)p;
+	size = st.st_size;
+	hdr = (const result_header *)base;
+
+	/*
+	 * Check that the header belongs to this format and that every section is aligned and lies
+	 * inside the file. The checks are written so that a corrupt offset can't overflow them.
+	 */
+	bool ok = memcmp(hdr->magic, RESULT_MAGIC, 4) == 0 && hdr->version == RESULT_VERSION
+			&& hdr->byte_order == RESULT_BYTE_ORDER && hdr->file_size <= size
+			&& section_ok(hdr->inputs_off, hdr->num_inputs, size)
+			&& section_ok(hdr->outputs_off, hdr->num_outputs, size)
+			&& section_ok(hdr->a_time_off, hdr->num_gates, size)
+			&& section_ok(hdr->r_time_off, hdr->num_gates, size)
+			&& section_ok(hdr->slack_off, hdr->num_gates, size)
+			&& section_ok(hdr->a_time_min_off, hdr->num_gates, size)
+			&& section_ok(hdr->r_time_early_off, hdr->num_gates, size)
+			&& section_ok(hdr->hold_slack_off, hdr->num_gates, size);
+	if(ok && has_names()){
+		/* name() slices the blob with consecutive offsets, so they must not decrease nor pass its end */
+		ok = section_ok(hdr->name_off_off, hdr->num_gates + 1ULL, size) && hdr->names_off <= size;
+		const u32 *off = ok ? array(hdr->name_off_off) : NULL;
+		unsigned long long blob = ok ? size - hdr->names_off : 0;
+		for(u32 i=0; ok && i<hdr->num_gates; i++)
+			ok = off[i] <= off[i+1];
+		ok = ok && off[hdr->num_gates] <= blob;
+	}
+	if(!ok){
+		cerr<<"Not a valid binary result file: "<<file<<endl;
+		close();
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * close - unmaps the result file
+ */
+void timing_result::close(){
+	if(base != NULL) munmap((void *)base, size);
+	base = NULL;
+	size = 0;
+	hdr = NULL;
+}
+
+/*
+ * name - Returns the name of the net driven by gate 'id', empty if the file has no names
+ */
+string timing_result::name(u32 id){
+	if(!has_names()) return "";
+	const u32 *off = array(hdr->name_off_off);
+	return string(base + hdr->names_off + off[id], off[id+1] - off[id]);
+}
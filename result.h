@@ -0,0 +1,113 @@
+/*
+ * This header file contains the timing result formats written by sta.
+ * Besides the text .out format there is a binary format made of a fixed header followed by
+ * fixed width arrays indexed by gate id, so a consumer can mmap the file and read the timing
+ * of any gate in O(1) without parsing. The integers are stored in host byte order.
+ *
+ * Binary layout, every section starts at an 8 byte aligned offset given in the header:
+ *   result_header
+ *   u32 inputs[num_inputs]		gate ids of the INPUT gates
+ *   u32 outputs[num_outputs]	gate ids of the OUTPUT gates
+ *   u32 a_time[num_gates]
+ *   u32 r_time[num_gates]
+ *   u32 slack[num_gates]
+ *   u32 a_time_min[num_gates]
+ *   u32 r_time_early[num_gates]
+ *   u32 hold_slack[num_gates]
+ *   optional, if RESULT_HAS_NAMES is set:
+ *   u32 name_off[num_gates+1]	name of gate i is the bytes [name_off[i], name_off[i+1]) of the blob
+ *   char names[]				net driven by each gate (the input net for OUTPUT gates), not NUL terminated
+ */
+
+#ifndef __RESULT_H
+#define __RESULT_H
+
+#include "netlist.h"
+#include <ostream>
+#include <cstddef>
+
+#define RESULT_MAGIC		"STAR"
+#define RESULT_VERSION		2
+#define RESULT_BYTE_ORDER	0x01020304	/* Reads back differently on a host with the other byte order */
+
+#define RESULT_HAS_NAMES	0x1			/* Flag: the names section is present */
+
+/* Header at the start of a binary result file */
+struct result_header{
+	char				magic[4];		/* RESULT_MAGIC */
+	u32					version;		/* RESULT_VERSION */
+	u32					byte_order;		/* RESULT_BYTE_ORDER */
+	u32					flags;			/* RESULT_HAS_NAMES */
+	u32					num_gates;		/* Length of the per gate arrays */
+	u32					max_at;			/* Maximum arrival time over all gates */
+	u32					min_at;			/* Minimum early arrival time over the output gates */
+	u32					num_inputs;		/* Length of the inputs array */
+	u32					num_outputs;	/* Length of the outputs array */
+	u32					reserved;		/* Keeps the offsets 8 byte aligned */
+	unsigned long long	inputs_off;		/* File offsets of the sections */
+	unsigned long long	outputs_off;
+	unsigned long long	a_time_off;
+	unsigned long long	r_time_off;
+	unsigned long long	slack_off;
+	unsigned long long	a_time_min_off;
+	unsigned long long	r_time_early_off;
+	unsigned long long	hold_slack_off;
+	unsigned long long	name_off_off;
+	unsigned long long	names_off;
+	unsigned long long	file_size;		/* Total size, used to validate the offsets */
+};
+
+/*
+ * This class abstracts a binary result file mapped into memory. All the accessors are O(1)
+ * and read straight from the mapping.
+ */
+class timing_result{
+	const char			*base;		/* Start of the mapping, NULL if nothing is open */
+	size_t				size;		/* Size of the mapping */
+	const result_header	*hdr;
+
+	const u32 *array(unsigned long long off){ return (const u32 *)(base + off); }
+
+	/* Not copyable, owns the mapping */
+	timing_result(const timing_result &);
+	timing_result &operator=(const timing_result &);
+
+	public:
+	timing_result():base(NULL), size(0), hdr(NULL){}
+	~timing_result(){ close(); }
+
+	/* For description of these function see corresponding .cpp file */
+	int open(const char *file);
+	void close();
+	std::string name(u32 id);
+
+	u32 num_gates(){ return hdr->num_gates; }
+	u32 max_at(){ return hdr->max_at; }
+	u32 min_at(){ return hdr->min_at; }
+	u32 num_inputs(){ return hdr->num_inputs; }
+	u32 num_outputs(){ return hdr->num_outputs; }
+	bool has_names(){ return (hdr->flags & RESULT_HAS_NAMES) != 0; }
+	const u32 *inputs(){ return array(hdr->inputs_off); }
+	const u32 *outputs(){ return array(hdr->outputs_off); }
+	const u32 *a_times(){ return array(hdr->a_time_off); }
+	const u32 *r_times(){ return array(hdr->r_time_off); }
+	const u32 *slacks(){ return array(hdr->slack_off); }
+	const u32 *a_times_min(){ return array(hdr->a_time_min_off); }
+	const u32 *r_times_early(){ return array(hdr->r_time_early_off); }
+	const u32 *hold_slacks(){ return array(hdr->hold_slack_off); }
+	u32 a_time(u32 id){ return a_times()[id]; }
+	u32 r_time(u32 id){ return r_times()[id]; }
+	u32 slack(u32 id){ return slacks()[id]; }
+	u32 a_time_min(u32 id){ return a_times_min()[id]; }
+	u32 r_time_early(u32 id){ return r_times_early()[id]; }
+	u32 hold_slack(u32 id){ return hold_slacks()[id]; }
+};
+
+/* For description of these function see result.cpp */
+int write_binary_result(class circuit &c, u32 max_at, u32 min_at, const char *file, bool names);
+void write_text_result(std::ostream &out, u32 max_at, const std::vector<u32> &inputs, const std::vector<u32> &outputs,
+					   const u32 *a_time, const u32 *slack, const u32 *a_time_min, const u32 *hold_slack, u32 num_gates);
+void write_text_result(std::ostream &out, class circuit &c, u32 max_at);
+int convert_result(const char *bin_file, const char *text_file);
+
+#endif